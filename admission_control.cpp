@@ -0,0 +1,103 @@
+// admission_control.cpp
+// Implementation of the admission controller
+
+#include "admission_control.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+AdmissionController::AdmissionController(AdmissionConfig config)
+    : config_(config) {
+}
+
+void AdmissionController::Tick(const std::map<std::string, std::shared_ptr<PeerConnectionHandler>>& sessions) {
+    cpu_ = cpu_meter_.Sample();
+    auto now = std::chrono::steady_clock::now();
+    auto warmup = std::chrono::seconds(config_.warmup_seconds);
+
+    // Forget sessions that went away without RemoveSession
+    for (auto it = admitted_at_.begin(); it != admitted_at_.end();) {
+        it = sessions.count(it->first) ? std::next(it) : admitted_at_.erase(it);
+    }
+
+    if (sessions.empty()) {
+        baseline_cpu_ = baseline_cpu_ == 0 ? cpu_ : 0.8 * baseline_cpu_ + 0.2 * cpu_;
+    }
+
+    int measured = 0;
+    double measured_egress_bps = 0;
+    double encode_cores = 0;
+    egress_bps_ = 0;
+    for (const auto& [id, handler] : sessions) {
+        SessionStats stats = handler->GetLatestStats();
+        egress_bps_ += stats.send_bitrate_bps;
+        auto admitted = admitted_at_.find(id);
+        if (admitted != admitted_at_.end() && now - admitted->second < warmup) {
+            continue;  // Still ramping; its estimate is reserved in Admit
+        }
+        measured++;
+        measured_egress_bps += stats.send_bitrate_bps;
+        encode_cores += stats.encode_cpu_cores;
+    }
+    if (measured > 0) {
+        double per_session = std::max(0.0, cpu_ - baseline_cpu_) / measured;
+        double encode = encode_cores / measured / ProcessCpuMeter::NumCores();
+        marginal_cpu_ = std::max(per_session, encode);
+        marginal_egress_bps_ = measured_egress_bps / measured;
+    }
+}
+
+AdmissionDecision AdmissionController::Admit(const std::string& session_id, const SessionEstimate& estimate) {
+    auto now = std::chrono::steady_clock::now();
+    int live = static_cast<int>(admitted_at_.size());
+    int warming = static_cast<int>(std::count_if(admitted_at_.begin(), admitted_at_.end(), [&](const auto& entry) {
+        return now - entry.second < std::chrono::seconds(config_.warmup_seconds);
+    }));
+
+    if (config_.max_sessions > 0 && live >= config_.max_sessions) {
+        return Reject("sessions", "session limit of " + std::to_string(config_.max_sessions) + " reached");
+    }
+
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(1);
+    if (config_.max_cpu > 0) {
+        // The warming sessions and this one each add the marginal cost
+        double per_session = marginal_cpu_ > 0 ? marginal_cpu_
+                                               : estimate.pixels_per_second / 1e6 * config_.prior_cores_per_mpixel_s /
+                                                     ProcessCpuMeter::NumCores();
+        double predicted = cpu_ + per_session * (warming + 1);
+        if (predicted > config_.max_cpu) {
+            reason << "CPU at " << cpu_ * 100 << "%, +" << per_session * 100 << "% per session"
+                   << (marginal_cpu_ > 0 ? "" : " (estimated)") << " (" << warming
+                   << " still starting) would exceed the " << config_.max_cpu * 100 << "% budget";
+            return Reject("cpu", reason.str());
+        }
+    }
+    if (config_.max_egress_mbps > 0) {
+        double per_session_bps = marginal_egress_bps_ > 0 ? marginal_egress_bps_ : estimate.start_bitrate_bps;
+        double predicted_bps = egress_bps_ + per_session_bps * (warming + 1);
+        if (predicted_bps > config_.max_egress_mbps * 1000000.0) {
+            reason << "egress at " << egress_bps_ / 1000000.0 << " Mbps, +" << per_session_bps / 1000000.0
+                   << " Mbps per session (" << warming << " still starting) would exceed the "
+                   << config_.max_egress_mbps << " Mbps budget";
+            return Reject("egress", reason.str());
+        }
+    }
+
+    admitted_at_[session_id] = now;
+    return AdmissionDecision();
+}
+
+void AdmissionController::RemoveSession(const std::string& session_id) {
+    admitted_at_.erase(session_id);
+}
+
+AdmissionDecision AdmissionController::Reject(const std::string& limit, const std::string& reason) {
+    rejected_[limit]++;
+    AdmissionDecision decision;
+    decision.admitted = false;
+    decision.limit = limit;
+    decision.reason = "Server at capacity: " + reason;
+    return decision;
+}
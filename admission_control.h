@@ -0,0 +1,82 @@
+// admission_control.h
+// Rejects new sessions that would push the server past its CPU or egress budget
+
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include "cpu_usage.h"
+#include "peer_connection_handler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+struct AdmissionConfig {
+    double max_cpu = 0.90;        // Fraction of all cores; 0 = no CPU budget
+    double max_egress_mbps = 0;   // All sessions together; 0 = no egress budget
+    int max_sessions = 0;         // 0 = no limit
+
+    // A new session's cost shows up in the measurements only after it has
+    // connected and ramped; until then its estimate is reserved
+    int warmup_seconds = 5;
+
+    // CPU a session is assumed to cost until one has been measured: cores
+    // per megapixel per second it sends (VP8 realtime, 720p30 ~ 0.4 cores)
+    double prior_cores_per_mpixel_s = 0.015;
+};
+
+// What a new session is expected to cost before it has been measured,
+// summed over the tracks it will send
+struct SessionEstimate {
+    int start_bitrate_bps = 0;
+    double pixels_per_second = 0;
+};
+
+struct AdmissionDecision {
+    bool admitted = true;
+    std::string limit;    // "cpu", "egress" or "sessions" when rejected
+    std::string reason;   // Human-readable, for the signaling error
+};
+
+// Estimates what one more session costs from the live sessions: process CPU
+// above the idle baseline divided by the measured sessions (at least their
+// encode time), and their mean send bitrate. Until a session has been
+// measured, the new session's own estimate stands in, so a burst of offers
+// at startup is still held to the budget. An offer is admitted only if
+// current load plus the reserved and new sessions' costs fits the budget,
+// so existing viewers keep their quality instead of all degrading together.
+// Tick and Admit must be serialized by the caller (the server's session lock).
+class AdmissionController {
+public:
+    explicit AdmissionController(AdmissionConfig config = AdmissionConfig());
+
+    // Called once per second with every live session
+    void Tick(const std::map<std::string, std::shared_ptr<PeerConnectionHandler>>& sessions);
+
+    // estimate: the new session's cost while no session has been measured yet
+    AdmissionDecision Admit(const std::string& session_id, const SessionEstimate& estimate);
+    void RemoveSession(const std::string& session_id);
+
+    double marginal_cpu() const { return marginal_cpu_; }
+    double marginal_egress_bps() const { return marginal_egress_bps_; }
+    const std::map<std::string, uint64_t>& rejected() const { return rejected_; }
+
+private:
+    AdmissionDecision Reject(const std::string& limit, const std::string& reason);
+
+    AdmissionConfig config_;
+    ProcessCpuMeter cpu_meter_;
+
+    double cpu_ = 0;                  // Fraction of all cores, last tick
+    double baseline_cpu_ = 0;         // With no sessions (frame source, idle threads)
+    double marginal_cpu_ = 0;         // Per measured session, fraction of all cores
+    double egress_bps_ = 0;
+    double marginal_egress_bps_ = 0;
+
+    std::map<std::string, std::chrono::steady_clock::time_point> admitted_at_;
+    std::map<std::string, uint64_t> rejected_;  // limit -> offers
+};
+
+#endif // ADMISSION_CONTROL_H
@@ -0,0 +1,271 @@
+// async_logger.cpp
+// Implementation of the lock-free log ring and its writer thread
+
+#include "async_logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+int64_t WallNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t SteadyNowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* LevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::kDebug: return "debug";
+        case LogLevel::kInfo: return "info";
+        case LogLevel::kWarning: return "warning";
+        case LogLevel::kError: return "error";
+    }
+    return "info";
+}
+
+// "2026-01-31T12:34:56.789 level=info "
+void AppendPrefix(std::string* out, int64_t time_us, LogLevel level) {
+    std::time_t seconds = static_cast<std::time_t>(time_us / 1000000);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char prefix[64];
+    size_t length = std::strftime(prefix, sizeof(prefix), "%Y-%m-%dT%H:%M:%S", &local);
+    length += std::snprintf(prefix + length, sizeof(prefix) - length, ".%03d level=%s ",
+                            static_cast<int>(time_us / 1000 % 1000), LevelName(level));
+    out->append(prefix, length);
+}
+
+// Idle writer poll interval; records wait at most this long
+constexpr auto kWriterPoll = std::chrono::milliseconds(10);
+
+} // namespace
+
+AsyncLogger& AsyncLogger::Instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : slots_(new Slot[kCapacity]) {
+    for (size_t i = 0; i < kCapacity; i++) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+AsyncLogger::~AsyncLogger() {
+    Stop();
+}
+
+bool AsyncLogger::Start(const AsyncLoggerConfig& config) {
+    if (running_) {
+        return true;
+    }
+    if (!config.path.empty()) {
+        file_ = std::fopen(config.path.c_str(), "a");
+        if (!file_) {
+            return false;
+        }
+    }
+    min_level_ = config.min_level;
+    max_records_per_second_ = config.max_records_per_second;
+    running_ = true;
+    thread_ = std::thread([this]() { Run(); });
+    return true;
+}
+
+void AsyncLogger::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    thread_.join();
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool AsyncLogger::AllowRate() {
+    if (max_records_per_second_ <= 0) {
+        return true;
+    }
+    // Fixed one-second windows; a racing reset may let a few extra through
+    int64_t second = SteadyNowSeconds();
+    int64_t window = rate_second_.load(std::memory_order_relaxed);
+    if (window != second && rate_second_.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        rate_count_.store(0, std::memory_order_relaxed);
+    }
+    return rate_count_.fetch_add(1, std::memory_order_relaxed) < max_records_per_second_;
+}
+
+void AsyncLogger::Submit(LogLevel level, const char* text, size_t length) {
+    if (level < LogLevel::kWarning && !AllowRate()) {
+        dropped_rate_++;
+        return;
+    }
+
+    // Bounded MPMC ring (Vyukov): a slot is free for position pos when its
+    // sequence equals pos, and holds a record for the reader at pos + 1
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[pos & (kCapacity - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropped_full_++;
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time_us = WallNowUs();
+    slot->level = level;
+    slot->length = static_cast<uint32_t>(std::min(length, kRecordBytes));
+    std::memcpy(slot->text, text, slot->length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AsyncLogger::Drain(std::string* batch) {
+    bool any = false;
+    while (true) {
+        Slot& slot = slots_[dequeue_pos_ & (kCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+            return any;
+        }
+        AppendPrefix(batch, slot.time_us, slot.level);
+        batch->append(slot.text, slot.length);
+        batch->push_back('\n');
+        slot.sequence.store(dequeue_pos_ + kCapacity, std::memory_order_release);
+        dequeue_pos_++;
+        written_++;
+        any = true;
+    }
+}
+
+void AsyncLogger::Run() {
+    std::FILE* out = file_ ? file_ : stdout;
+    std::string batch;
+    uint64_t reported_full = 0;
+    uint64_t reported_rate = 0;
+    auto next_drop_report = std::chrono::steady_clock::now();
+
+    while (true) {
+        bool stopping = !running_;
+        batch.clear();
+        bool any = Drain(&batch);
+
+        // Drops are reported at most once a second, bypassing the ring
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_drop_report && (dropped_full_ != reported_full || dropped_rate_ != reported_rate)) {
+            uint64_t full = dropped_full_;
+            uint64_t rate = dropped_rate_;
+            AppendPrefix(&batch, WallNowUs(), LogLevel::kWarning);
+            batch += "event=log-dropped ring_full=" + std::to_string(full - reported_full) +
+                     " rate_limited=" + std::to_string(rate - reported_rate) + "\n";
+            reported_full = full;
+            reported_rate = rate;
+            next_drop_report = now + std::chrono::seconds(1);
+        }
+
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), out);
+            std::fflush(out);
+        }
+        if (stopping) {
+            return;
+        }
+        if (!any) {
+            std::this_thread::sleep_for(kWriterPoll);
+        }
+    }
+}
+
+LogRecord::LogRecord(LogLevel level, const char* event)
+    : level_(level),
+      enabled_(AsyncLogger::Instance().Enabled(level)) {
+    if (enabled_) {
+        Append("event=", 6);
+        Append(event, std::strlen(event));
+    }
+}
+
+LogRecord::~LogRecord() {
+    if (enabled_) {
+        AsyncLogger::Instance().Submit(level_, text_, length_);
+    }
+}
+
+LogRecord& LogRecord::Kv(const char* key, const std::string& value) {
+    if (!enabled_) return *this;
+    AppendKey(key);
+    bool quote = value.empty() || value.find_first_of(" =\"\\\n") != std::string::npos;
+    if (!quote) {
+        Append(value.data(), value.size());
+        return *this;
+    }
+    Append("\"", 1);
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            Append("\\", 1);
+            Append(&c, 1);
+        } else if (c == '\n') {
+            Append("\\n", 2);
+        } else if (c != '\r') {
+            Append(&c, 1);
+        }
+    }
+    Append("\"", 1);
+    return *this;
+}
+
+LogRecord& LogRecord::Kv(const char* key, const char* value) {
+    if (!enabled_) return *this;
+    return Kv(key, std::string(value ? value : ""));
+}
+
+LogRecord& LogRecord::Kv(const char* key, double value) {
+    if (!enabled_) return *this;
+    AppendKey(key);
+    char number[32];
+    int length = std::snprintf(number, sizeof(number), "%.2f", value);
+    Append(number, static_cast<size_t>(length));
+    return *this;
+}
+
+LogRecord& LogRecord::KvInteger(const char* key, long long value) {
+    if (!enabled_) return *this;
+    AppendKey(key);
+    char number[24];
+    int length = std::snprintf(number, sizeof(number), "%lld", value);
+    Append(number, static_cast<size_t>(length));
+    return *this;
+}
+
+void LogRecord::AppendKey(const char* key) {
+    Append(" ", 1);
+    Append(key, std::strlen(key));
+    Append("=", 1);
+}
+
+void LogRecord::Append(const char* data, size_t length) {
+    size_t room = sizeof(text_) - length_;
+    size_t count = length < room ? length : room;
+    std::memcpy(text_ + length_, data, count);
+    length_ += count;
+}
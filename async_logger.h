@@ -0,0 +1,122 @@
+// async_logger.h
+// Structured key=value logging that never blocks the calling thread
+
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel { kDebug, kInfo, kWarning, kError };
+
+struct AsyncLoggerConfig {
+    std::string path;                     // Empty = stdout
+    LogLevel min_level = LogLevel::kInfo;
+    // Debug and info records per second, across all threads (0 = no limit);
+    // warnings and errors are never rate limited
+    int max_records_per_second = 1000;
+};
+
+// Records are formatted on the calling thread into a fixed-size slot of a
+// bounded lock-free ring (many producers, one consumer) and written by a
+// background thread, so signaling, network and frame threads never wait on
+// the terminal or a file. A record that finds the ring full or the rate
+// budget spent is dropped and counted; the writer reports the drops.
+// Records submitted before Start() wait in the ring (dropped once it fills).
+class AsyncLogger {
+public:
+    static constexpr size_t kCapacity = 4096;    // Records, power of two
+    static constexpr size_t kRecordBytes = 480;  // Longer records are truncated
+
+    static AsyncLogger& Instance();
+    ~AsyncLogger();
+
+    // Starts the writer thread; false if the log file can't be opened
+    bool Start(const AsyncLoggerConfig& config);
+    // Writes what's queued and stops the writer
+    void Stop();
+
+    bool Enabled(LogLevel level) const { return level >= min_level_.load(std::memory_order_relaxed); }
+
+    // text is the record without timestamp and level (added by the writer)
+    void Submit(LogLevel level, const char* text, size_t length);
+
+    uint64_t written() const { return written_; }
+    uint64_t dropped_full() const { return dropped_full_; }
+    uint64_t dropped_rate() const { return dropped_rate_; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        int64_t time_us;
+        LogLevel level;
+        uint32_t length;
+        char text[kRecordBytes];
+    };
+
+    AsyncLogger();
+    bool AllowRate();
+    void Run();
+    // Appends the queued records to batch; false if there were none
+    bool Drain(std::string* batch);
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<uint64_t> enqueue_pos_{0};
+    alignas(64) uint64_t dequeue_pos_ = 0;  // Writer thread only
+
+    std::atomic<LogLevel> min_level_{LogLevel::kInfo};
+    int max_records_per_second_ = 1000;
+    std::atomic<int64_t> rate_second_{0};
+    std::atomic<int> rate_count_{0};
+
+    std::FILE* file_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_full_{0};
+    std::atomic<uint64_t> dropped_rate_{0};
+};
+
+// Builds one record and submits it when it goes out of scope:
+//   LogRecord(LogLevel::kInfo, "ice-state").Session(id).Kv("state", "connected");
+// Formats into a stack buffer; costs nothing but the level check when the
+// level is disabled.
+class LogRecord {
+public:
+    LogRecord(LogLevel level, const char* event);
+    ~LogRecord();
+
+    LogRecord(const LogRecord&) = delete;
+    LogRecord& operator=(const LogRecord&) = delete;
+
+    // Omitted when empty (sessions created outside signaling)
+    LogRecord& Session(const std::string& session_id) {
+        return session_id.empty() ? *this : Kv("session", session_id);
+    }
+    LogRecord& Kv(const char* key, const std::string& value);
+    LogRecord& Kv(const char* key, const char* value);
+    LogRecord& Kv(const char* key, double value);
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogRecord& Kv(const char* key, T value) {
+        return KvInteger(key, static_cast<long long>(value));
+    }
+
+private:
+    LogRecord& KvInteger(const char* key, long long value);
+    void AppendKey(const char* key);
+    void Append(const char* data, size_t length);
+
+    LogLevel level_;
+    bool enabled_;
+    size_t length_ = 0;
+    char text_[AsyncLogger::kRecordBytes];
+};
+
+#endif // ASYNC_LOGGER_H
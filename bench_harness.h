@@ -0,0 +1,87 @@
+// bench_harness.h
+// Self-contained microbenchmark harness (no external dependencies)
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Result {
+    std::string name;
+    int64_t iterations;      // Iterations per repetition
+    double ns_per_op;        // Median over repetitions
+    double min_ns_per_op;
+    double max_ns_per_op;
+    double bytes_per_op;     // 0 if not a throughput benchmark
+};
+
+// Keeps the compiler from discarding a computed value
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Runs fn repeatedly: calibrates an iteration count that takes about
+// target_ms, then reports the median of several timed repetitions
+template <typename Fn>
+Result Run(const std::string& name, double bytes_per_op, Fn&& fn,
+           int repetitions = 7, double target_ms = 50.0) {
+    using Clock = std::chrono::steady_clock;
+
+    int64_t iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (int64_t i = 0; i < iterations; i++) fn();
+        double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (elapsed_ms >= target_ms / 4 || iterations >= (int64_t(1) << 30)) {
+            if (elapsed_ms > 0) {
+                iterations = std::max<int64_t>(1, static_cast<int64_t>(iterations * target_ms / elapsed_ms));
+            }
+            break;
+        }
+        iterations *= 4;
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = Clock::now();
+        for (int64_t i = 0; i < iterations; i++) fn();
+        double elapsed_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        samples.push_back(elapsed_ns / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    return Result{name, iterations, samples[samples.size() / 2], samples.front(), samples.back(), bytes_per_op};
+}
+
+// Prints results as one JSON document (stable field order for diffing)
+inline void PrintJson(const std::vector<Result>& results, FILE* out = stdout) {
+    std::fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double mb_per_s = r.bytes_per_op > 0 ? r.bytes_per_op / r.ns_per_op * 1000.0 : 0.0;
+        std::fprintf(out,
+                     "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": %.1f, "
+                     "\"min_ns_per_op\": %.1f, \"max_ns_per_op\": %.1f, \"mb_per_s\": %.1f}%s\n",
+                     r.name.c_str(), static_cast<long long>(r.iterations), r.ns_per_op,
+                     r.min_ns_per_op, r.max_ns_per_op, mb_per_s,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+} // namespace bench
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,80 @@
+// bitrate_profile.cpp
+// Implementation of bitrate profile selection and bandwidth history
+
+#include "bitrate_profile.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+struct ProfileTier {
+    const char* name;
+    int64_t pixel_rate;  // width * height * fps the tier is sized for
+    int low_bps;         // Expected bitrate range for VP8 at this pixel rate
+    int high_bps;
+};
+
+// Same numbers as the expected bitrate table in README.txt
+const ProfileTier kTiers[] = {
+    {"1080p30", 1920LL * 1080 * 30, 2000000, 4000000},
+    {"1440p30", 2560LL * 1440 * 30, 4000000, 8000000},
+    {"1080p60", 1920LL * 1080 * 60, 4000000, 8000000},
+    {"2160p30", 3840LL * 2160 * 30, 10000000, 20000000},
+    {"2160p60", 3840LL * 2160 * 60, 20000000, 40000000},
+    {"4320p30", 7680LL * 4320 * 30, 40000000, 80000000},
+};
+
+} // namespace
+
+BitrateProfile SelectBitrateProfile(int width, int height, int fps) {
+    int64_t pixel_rate = static_cast<int64_t>(width) * height * fps;
+
+    // Smallest tier that covers the stream; scale the tier linearly below
+    // 1080p30 and above 8K30 so odd sizes still get sensible numbers
+    const ProfileTier* tier = &kTiers[0];
+    for (const ProfileTier& t : kTiers) {
+        tier = &t;
+        if (pixel_rate <= t.pixel_rate) break;
+    }
+
+    double scale = 1.0;
+    if (pixel_rate < kTiers[0].pixel_rate || pixel_rate > tier->pixel_rate) {
+        scale = static_cast<double>(pixel_rate) / tier->pixel_rate;
+    }
+
+    BitrateProfile profile;
+    profile.name = tier->name;
+    profile.start_bitrate_bps = std::max(300000, static_cast<int>(tier->low_bps * scale));
+    profile.max_bitrate_bps = std::max(profile.start_bitrate_bps, static_cast<int>(tier->high_bps * scale));
+    // Let the congestion controller back off well below the start rate on bad links
+    profile.min_bitrate_bps = std::max(100000, profile.start_bitrate_bps / 4);
+    return profile;
+}
+
+BitrateProfile SeedBitrateProfile(const BitrateProfile& profile, int measured_bps) {
+    if (measured_bps <= 0) {
+        return profile;
+    }
+
+    BitrateProfile seeded = profile;
+    seeded.name = profile.name + "+seeded";
+    // Start slightly under the last measurement so a marginal link isn't overshot
+    seeded.start_bitrate_bps = std::clamp(static_cast<int>(measured_bps * 0.9),
+                                          profile.min_bitrate_bps, profile.max_bitrate_bps);
+    return seeded;
+}
+
+void BandwidthHistory::Record(const std::string& client_id, int bitrate_bps) {
+    if (client_id.empty() || bitrate_bps <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    bitrates_[client_id] = bitrate_bps;
+}
+
+int BandwidthHistory::Lookup(const std::string& client_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = bitrates_.find(client_id);
+    return it != bitrates_.end() ? it->second : 0;
+}
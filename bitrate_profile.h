@@ -0,0 +1,40 @@
+// bitrate_profile.h
+// Per-session start/min/max bitrate profiles chosen by resolution and frame rate
+
+#ifndef BITRATE_PROFILE_H
+#define BITRATE_PROFILE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+// Bitrates handed to PeerConnectionInterface::SetBitrate and the sender's encoding
+struct BitrateProfile {
+    std::string name;
+    int min_bitrate_bps;
+    int start_bitrate_bps;  // Where the congestion controller begins
+    int max_bitrate_bps;
+};
+
+// Picks a profile from the expected bitrate table (see README.txt):
+// start at the low end of the expected range so 4K viewers skip the ramp
+BitrateProfile SelectBitrateProfile(int width, int height, int fps);
+
+// Moves the start bitrate to a client's previously measured bandwidth
+// (with some headroom), clamped to the profile's range
+BitrateProfile SeedBitrateProfile(const BitrateProfile& profile, int measured_bps);
+
+// Last measured outgoing bandwidth per client, used to seed the next session
+class BandwidthHistory {
+public:
+    void Record(const std::string& client_id, int bitrate_bps);
+
+    // Returns 0 if the client has not been seen
+    int Lookup(const std::string& client_id) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, int> bitrates_;
+};
+
+#endif // BITRATE_PROFILE_H
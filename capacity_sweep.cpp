@@ -0,0 +1,358 @@
+// capacity_sweep.cpp
+// Implementation of the capacity sweep runner
+
+#include "capacity_sweep.h"
+#include "bitrate_profile.h"
+#include "cpu_usage.h"
+#include "peer_connection_handler.h"
+#include "signaling_json.h"
+#include "synthetic_viewer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Thread names of the synthetic viewers' factory (kept short: Linux
+// truncates thread names to 15 characters). Its network, worker and
+// signaling threads end in the suffix; its task queue threads (receive
+// streams, pacer, ...) start with the prefix.
+const char kViewerThreadSuffix[] = "-sv";
+const char kViewerTaskQueuePrefix[] = "sv-";
+
+bool IsViewerThread(const std::string& name) {
+    return name.find(kViewerThreadSuffix) != std::string::npos ||
+           name.compare(0, sizeof(kViewerTaskQueuePrefix) - 1, kViewerTaskQueuePrefix) == 0;
+}
+
+// How long a new step waits for its viewers' ICE to connect
+const int kConnectTimeoutSeconds = 10;
+
+std::vector<std::string> SplitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+bool ParseIntList(const std::string& list, std::vector<int>* values) {
+    values->clear();
+    for (const std::string& item : SplitList(list)) {
+        int value = std::atoi(item.c_str());
+        if (value <= 0) return false;
+        values->push_back(value);
+    }
+    return !values->empty();
+}
+
+std::string UtcTimestamp() {
+    std::time_t now = std::time(nullptr);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+} // namespace
+
+bool CapacitySweepConfig::Parse(const std::string& resolutions_list, const std::string& fps_list,
+                                const std::string& codecs_list, const std::string& viewers_list,
+                                std::string* error) {
+    if (!resolutions_list.empty()) {
+        resolutions.clear();
+        for (const std::string& item : SplitList(resolutions_list)) {
+            size_t x = item.find('x');
+            int width = std::atoi(item.substr(0, x).c_str());
+            int height = x == std::string::npos ? 0 : std::atoi(item.substr(x + 1).c_str());
+            if (width <= 0 || height <= 0) {
+                *error = "bad resolution \"" + item + "\" (expected WIDTHxHEIGHT)";
+                return false;
+            }
+            resolutions.push_back({width, height});
+        }
+    }
+    if (!fps_list.empty() && !ParseIntList(fps_list, &fps)) {
+        *error = "bad frame rate list \"" + fps_list + "\"";
+        return false;
+    }
+    if (!codecs_list.empty()) {
+        codecs = SplitList(codecs_list);
+        for (std::string& codec : codecs) {
+            std::transform(codec.begin(), codec.end(), codec.begin(), ::toupper);
+            if (codec != "VP8" && codec != "VP9") {
+                *error = "unsupported codec \"" + codec + "\" (expected VP8 or VP9)";
+                return false;
+            }
+        }
+    }
+    if (!viewers_list.empty()) {
+        if (!ParseIntList(viewers_list, &viewer_counts)) {
+            *error = "bad viewer count list \"" + viewers_list + "\"";
+            return false;
+        }
+        std::sort(viewer_counts.begin(), viewer_counts.end());
+    }
+    return true;
+}
+
+// One server session and the synthetic viewer attached to it
+struct CapacitySweep::Session {
+    FactoryShard* shard = nullptr;
+    std::shared_ptr<PeerConnectionHandler> handler;
+    std::shared_ptr<SyntheticViewer> viewer;
+};
+
+CapacitySweep::CapacitySweep(const CapacitySweepConfig& config, FactoryShardPool* server_shards,
+                             SourceFactory make_source)
+    : config_(config),
+      server_shards_(server_shards),
+      make_source_(make_source) {
+}
+
+bool CapacitySweep::Run(const std::atomic<bool>& running) {
+    FactoryOptions viewer_options;
+    viewer_options.video_only = true;
+    viewer_options.decode_video = false;
+    viewer_options.task_queue_prefix = kViewerTaskQueuePrefix;
+    if (!viewer_shard_.Start(kViewerThreadSuffix, viewer_options)) {
+        std::cerr << "Capacity sweep: failed to create the viewer factory" << std::endl;
+        return false;
+    }
+
+    std::cout << "\n========== CAPACITY SWEEP ==========\n";
+
+    for (const std::string& codec : config_.codecs) {
+        for (const auto& resolution : config_.resolutions) {
+            for (int fps : config_.fps) {
+                if (!running) break;
+
+                std::shared_ptr<EncodedVideoSource> source = make_source_(resolution.width, resolution.height, fps);
+                source->Start();
+
+                SweepKnee knee;
+                knee.width = resolution.width;
+                knee.height = resolution.height;
+                knee.fps = fps;
+                knee.codec = codec;
+
+                std::vector<std::unique_ptr<Session>> sessions;
+                for (int viewers : config_.viewer_counts) {
+                    if (!running) break;
+                    SweepStep step = RunStep(source, codec, &sessions, viewers, running);
+                    steps_.push_back(step);
+
+                    std::cout << "  " << step.width << "x" << step.height << "@" << step.fps << " " << step.codec
+                              << ", " << step.viewers << " viewers: " << step.achieved_fps << " fps (slowest "
+                              << step.min_session_fps << "), encode " << step.encode_ms << " ms, egress "
+                              << step.egress_mbps << " Mbps, server CPU " << step.server_cpu_cores << " cores - "
+                              << (step.passed ? "ok" : "FAIL (" + step.limit + ")") << std::endl;
+
+                    if (!step.passed) {
+                        knee.limit = step.limit;
+                        break;
+                    }
+                    knee.max_viewers = viewers;
+                }
+                knees_.push_back(knee);
+
+                // Viewers first: once closed they stop trickling into the handlers
+                for (auto& session : sessions) {
+                    session->viewer.reset();
+                    session->handler.reset();
+                    server_shards_->Release(session->shard);
+                }
+                sessions.clear();
+                source->Stop();
+            }
+        }
+    }
+
+    viewer_shard_.Stop();
+
+    std::cout << "\nKnees (most viewers that kept up):\n";
+    for (const SweepKnee& knee : knees_) {
+        std::cout << "  " << knee.width << "x" << knee.height << "@" << knee.fps << " " << knee.codec << ": "
+                  << knee.max_viewers << (knee.limit.empty() ? " (no limit reached)" : " (" + knee.limit + ")")
+                  << "\n";
+    }
+
+    if (!WriteReport()) {
+        std::cerr << "Capacity sweep: failed to write " << config_.report_path << std::endl;
+        return false;
+    }
+    std::cout << "Report written to " << config_.report_path << std::endl;
+    return true;
+}
+
+SweepStep CapacitySweep::RunStep(const std::shared_ptr<EncodedVideoSource>& source, const std::string& codec,
+                                 std::vector<std::unique_ptr<Session>>* sessions, int viewers,
+                                 const std::atomic<bool>& running) {
+    SweepStep step;
+    step.width = source->GetWidth();
+    step.height = source->GetHeight();
+    step.fps = source->GetFps();
+    step.codec = codec;
+    step.viewers = viewers;
+
+    // Add viewers up to this step's count (earlier ones keep streaming)
+    BitrateProfile profile = SelectBitrateProfile(step.width, step.height, step.fps);
+    while (static_cast<int>(sessions->size()) < viewers) {
+        auto session = std::make_unique<Session>();
+        session->shard = server_shards_->Acquire();
+
+        // Signaling is wired before the offer exists, so no callback can
+        // observe a half-built session
+        struct Link {
+            std::weak_ptr<PeerConnectionHandler> handler;
+            std::weak_ptr<SyntheticViewer> viewer;
+        };
+        auto link = std::make_shared<Link>();
+        session->handler = std::make_shared<PeerConnectionHandler>(
+            session->shard->factory(), source,
+            [link](const std::string& type, const std::string& message) {
+                if (auto viewer = link->viewer.lock()) viewer->OnSignaling(type, message);
+            });
+        session->handler->ApplyBitrateProfile(profile);
+        session->viewer = std::make_shared<SyntheticViewer>(
+            viewer_shard_.factory(), codec,
+            [link](const std::string& sdp) {
+                if (auto handler = link->handler.lock()) handler->HandleOffer(sdp);
+            },
+            [link](const std::string& candidate, const std::string& sdp_mid, int sdp_mline_index) {
+                if (auto handler = link->handler.lock()) handler->HandleIceCandidate(candidate, sdp_mid, sdp_mline_index);
+            });
+        link->handler = session->handler;
+        link->viewer = session->viewer;
+
+        bool started = session->viewer->Start();
+        sessions->push_back(std::move(session));
+        if (!started) break;
+    }
+
+    auto connect_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kConnectTimeoutSeconds);
+    while (running && std::chrono::steady_clock::now() < connect_deadline) {
+        step.connected = 0;
+        for (const auto& session : *sessions) {
+            step.connected += session->viewer->connected() ? 1 : 0;
+        }
+        if (step.connected == viewers) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (step.connected < viewers) {
+        step.limit = "connect";
+        return step;
+    }
+
+    // Poll every second through warmup (so rates have a previous snapshot)
+    // and accumulate over the measurement window
+    std::vector<double> session_fps(sessions->size(), 0);
+    double encode_ms_sum = 0;
+    double egress_bps_sum = 0;
+    int samples = 0;
+    ProcessCpuMeter process_cpu;
+    ThreadCpuMonitor thread_cpu;
+
+    for (int second = 0; running && second < config_.warmup_seconds + config_.measure_seconds; second++) {
+        if (second == config_.warmup_seconds) {
+            process_cpu.SampleCores();
+            thread_cpu.Sample();
+        }
+        for (const auto& session : *sessions) {
+            session->handler->PollStats();
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (second < config_.warmup_seconds) continue;
+
+        for (size_t i = 0; i < sessions->size(); i++) {
+            SessionStats stats = (*sessions)[i]->handler->GetLatestStats();
+            session_fps[i] += stats.frames_per_second;
+            encode_ms_sum += stats.encode_ms_per_frame;
+            egress_bps_sum += stats.send_bitrate_bps;
+        }
+        samples++;
+    }
+    if (samples == 0) {
+        step.limit = "interrupted";
+        return step;
+    }
+
+    double process_cores = process_cpu.SampleCores();
+    for (const ThreadCpuUsage& usage : thread_cpu.Sample()) {
+        if (IsViewerThread(usage.name)) {
+            step.viewer_cpu_cores += usage.cores;
+        }
+    }
+    step.server_cpu_cores = process_cores - step.viewer_cpu_cores;
+
+    double fps_sum = 0;
+    step.min_session_fps = -1;
+    for (double total : session_fps) {
+        double mean = total / samples;
+        fps_sum += mean;
+        step.min_session_fps = step.min_session_fps < 0 ? mean : std::min(step.min_session_fps, mean);
+    }
+    step.achieved_fps = fps_sum / sessions->size();
+    step.encode_ms = encode_ms_sum / (samples * sessions->size());
+    step.egress_mbps = egress_bps_sum / samples / 1000000.0;
+
+    if (step.min_session_fps < config_.min_fps_fraction * step.fps) {
+        step.limit = "fps";
+    } else if (step.encode_ms > 1000.0 / step.fps) {
+        step.limit = "encode";
+    } else if (step.server_cpu_cores / ProcessCpuMeter::NumCores() > config_.max_cpu) {
+        step.limit = "cpu";
+    }
+    step.passed = step.limit.empty();
+    return step;
+}
+
+bool CapacitySweep::WriteReport() const {
+    std::ofstream out(config_.report_path);
+    if (!out) return false;
+
+    // One step per line with a fixed key order, so two reports diff cleanly
+    out << std::fixed << std::setprecision(2);
+    out << "{\n";
+    out << "  \"generated\": \"" << UtcTimestamp() << "\",\n";
+    out << "  \"host\": {\"cpu_model\": \"" << EscapeJson(GetCpuModelName()) << "\", \"cores\": "
+        << ProcessCpuMeter::NumCores() << "},\n";
+    out << "  \"criteria\": {\"warmup_seconds\": " << config_.warmup_seconds
+        << ", \"measure_seconds\": " << config_.measure_seconds
+        << ", \"min_fps_fraction\": " << config_.min_fps_fraction
+        << ", \"max_cpu\": " << config_.max_cpu << "},\n";
+
+    out << "  \"steps\": [\n";
+    for (size_t i = 0; i < steps_.size(); i++) {
+        const SweepStep& step = steps_[i];
+        out << "    {\"width\": " << step.width << ", \"height\": " << step.height << ", \"fps\": " << step.fps
+            << ", \"codec\": \"" << step.codec << "\", \"viewers\": " << step.viewers
+            << ", \"connected\": " << step.connected
+            << ", \"achieved_fps\": " << step.achieved_fps << ", \"min_session_fps\": " << step.min_session_fps
+            << ", \"encode_ms\": " << step.encode_ms << ", \"egress_mbps\": " << step.egress_mbps
+            << ", \"server_cpu_cores\": " << step.server_cpu_cores
+            << ", \"viewer_cpu_cores\": " << step.viewer_cpu_cores
+            << ", \"passed\": " << (step.passed ? "true" : "false")
+            << ", \"limit\": \"" << step.limit << "\"}" << (i + 1 < steps_.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"knees\": [\n";
+    for (size_t i = 0; i < knees_.size(); i++) {
+        const SweepKnee& knee = knees_[i];
+        out << "    {\"width\": " << knee.width << ", \"height\": " << knee.height << ", \"fps\": " << knee.fps
+            << ", \"codec\": \"" << knee.codec << "\", \"max_viewers\": " << knee.max_viewers
+            << ", \"limit\": \"" << knee.limit << "\"}" << (i + 1 < knees_.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return static_cast<bool>(out);
+}
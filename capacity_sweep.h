@@ -0,0 +1,108 @@
+// capacity_sweep.h
+// Steps through resolution x fps x codec x viewer count with in-process
+// viewers and reports where the server stops keeping up
+
+#ifndef CAPACITY_SWEEP_H
+#define CAPACITY_SWEEP_H
+
+#include "encoded_video_source.h"
+#include "factory_shard.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CapacitySweepConfig {
+    struct Resolution {
+        int width;
+        int height;
+    };
+    std::vector<Resolution> resolutions = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    std::vector<int> fps = {30, 60};
+    std::vector<std::string> codecs = {"VP8", "VP9"};
+    std::vector<int> viewer_counts = {1, 2, 4, 8, 16, 32};
+
+    int warmup_seconds = 5;    // After the last viewer connected
+    int measure_seconds = 10;
+
+    // A step passes while every viewer gets min_fps_fraction of the source
+    // frame rate, encoding fits in the frame interval and the server uses
+    // less than max_cpu of the machine
+    double min_fps_fraction = 0.9;
+    double max_cpu = 0.9;
+
+    std::string report_path = "sweep_report.json";
+
+    // Parses comma-separated lists ("1280x720,1920x1080", "30,60",
+    // "VP8,VP9", "1,2,4,8"); empty strings keep the defaults
+    bool Parse(const std::string& resolutions, const std::string& fps, const std::string& codecs,
+               const std::string& viewers, std::string* error);
+};
+
+// Result of one (resolution, fps, codec, viewers) step
+struct SweepStep {
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    std::string codec;
+    int viewers = 0;
+    int connected = 0;
+
+    double achieved_fps = 0;      // Mean over sessions and seconds
+    double min_session_fps = 0;   // Slowest session's mean
+    double encode_ms = 0;         // Mean per frame
+    double egress_mbps = 0;       // All sessions
+    double server_cpu_cores = 0;  // Process CPU minus the synthetic viewers' threads
+    double viewer_cpu_cores = 0;
+
+    bool passed = false;
+    std::string limit;            // What failed: "fps", "encode", "cpu", "connect", "interrupted"
+};
+
+// Highest viewer count that passed for one (resolution, fps, codec)
+struct SweepKnee {
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    std::string codec;
+    int max_viewers = 0;
+    std::string limit;            // Empty when the largest count still passed
+};
+
+// Runs the sweep against the server's own factories. Viewers come from a
+// separate non-decoding factory whose threads are named "*-sv" (task queue
+// threads "sv-*") so their CPU can be taken out of the server's. Each
+// configuration ramps the viewer count until a step fails, then moves on;
+// the report is JSON with one object per step so runs can be diffed.
+class CapacitySweep {
+public:
+    using SourceFactory = std::function<std::shared_ptr<EncodedVideoSource>(int width, int height, int fps)>;
+
+    CapacitySweep(const CapacitySweepConfig& config, FactoryShardPool* server_shards, SourceFactory make_source);
+
+    // Blocks until done or running turns false; false if it could not start
+    bool Run(const std::atomic<bool>& running);
+
+    const std::vector<SweepStep>& steps() const { return steps_; }
+    const std::vector<SweepKnee>& knees() const { return knees_; }
+
+private:
+    struct Session;
+
+    SweepStep RunStep(const std::shared_ptr<EncodedVideoSource>& source, const std::string& codec,
+                      std::vector<std::unique_ptr<Session>>* sessions, int viewers,
+                      const std::atomic<bool>& running);
+    bool WriteReport() const;
+
+    CapacitySweepConfig config_;
+    FactoryShardPool* server_shards_;
+    SourceFactory make_source_;
+    FactoryShard viewer_shard_{0};
+
+    std::vector<SweepStep> steps_;
+    std::vector<SweepKnee> knees_;
+};
+
+#endif // CAPACITY_SWEEP_H
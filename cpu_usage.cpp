@@ -0,0 +1,164 @@
+// cpu_usage.cpp
+// Implementation of process CPU and memory usage sampling
+
+#include "cpu_usage.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+int64_t GetProcessCpuTimeUs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto to_us = [](const FILETIME& ft) {
+        ULARGE_INTEGER value;
+        value.LowPart = ft.dwLowDateTime;
+        value.HighPart = ft.dwHighDateTime;
+        return static_cast<int64_t>(value.QuadPart / 10);  // 100 ns units
+    };
+    return to_us(kernel) + to_us(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+int64_t GetProcessRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<int64_t>(counters.WorkingSetSize);
+#elif defined(__linux__)
+    // Second field of statm is resident pages
+    std::ifstream statm("/proc/self/statm");
+    int64_t size_pages = 0, resident_pages = 0;
+    if (!(statm >> size_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+std::string GetCpuModelName() {
+#ifdef __linux__
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            return colon != std::string::npos && colon + 2 <= line.size() ? line.substr(colon + 2) : "";
+        }
+    }
+#endif
+    return "";
+}
+
+ProcessCpuMeter::ProcessCpuMeter()
+    : last_cpu_us_(GetProcessCpuTimeUs()),
+      last_wall_(std::chrono::steady_clock::now()) {
+}
+
+double ProcessCpuMeter::Sample() {
+    return SampleCores() / NumCores();
+}
+
+double ProcessCpuMeter::SampleCores() {
+    int64_t cpu_us = GetProcessCpuTimeUs();
+    auto now = std::chrono::steady_clock::now();
+    int64_t wall_us = std::chrono::duration_cast<std::chrono::microseconds>(now - last_wall_).count();
+
+    double cores = wall_us > 0 ? static_cast<double>(cpu_us - last_cpu_us_) / wall_us : 0.0;
+    last_cpu_us_ = cpu_us;
+    last_wall_ = now;
+    return cores;
+}
+
+int ProcessCpuMeter::NumCores() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 1;
+}
+
+std::vector<ThreadCpuUsage> ThreadCpuMonitor::Sample() {
+    std::vector<ThreadCpuUsage> usage;
+#ifdef __linux__
+    auto now = std::chrono::steady_clock::now();
+    double wall_s = std::chrono::duration<double>(now - last_wall_).count();
+    bool have_baseline = !last_ticks_.empty();
+    last_wall_ = now;
+    
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return usage;
+    
+    static const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+    std::map<int, int64_t> ticks;
+    std::map<std::string, ThreadCpuUsage> by_name;
+    
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        int tid = std::atoi(entry->d_name);
+        
+        std::ifstream file("/proc/self/task/" + std::string(entry->d_name) + "/stat");
+        std::string stat;
+        std::getline(file, stat);
+        
+        // "tid (name) state ..." - the name may contain spaces, so split at the last ')'
+        size_t open = stat.find('(');
+        size_t close = stat.rfind(')');
+        if (open == std::string::npos || close == std::string::npos) continue;
+        std::string name = stat.substr(open + 1, close - open - 1);
+        
+        // utime and stime are fields 14 and 15; the state is field 3
+        std::istringstream fields(stat.substr(close + 2));
+        std::string field;
+        int64_t utime = 0, stime = 0;
+        for (int i = 3; i <= 15 && fields >> field; i++) {
+            if (i == 14) utime = std::atoll(field.c_str());
+            if (i == 15) stime = std::atoll(field.c_str());
+        }
+        ticks[tid] = utime + stime;
+        
+        ThreadCpuUsage& entry_usage = by_name[name];
+        entry_usage.name = name;
+        entry_usage.threads++;
+        if (have_baseline && wall_s > 0) {
+            auto last = last_ticks_.find(tid);
+            int64_t delta = ticks[tid] - (last != last_ticks_.end() ? last->second : 0);
+            entry_usage.cores += delta / ticks_per_second / wall_s;
+        }
+    }
+    closedir(dir);
+    last_ticks_.swap(ticks);
+    
+    for (auto& [name, entry_usage] : by_name) {
+        usage.push_back(entry_usage);
+    }
+    std::sort(usage.begin(), usage.end(), [](const ThreadCpuUsage& a, const ThreadCpuUsage& b) {
+        return a.cores > b.cores;
+    });
+#endif
+    return usage;
+}
@@ -0,0 +1,59 @@
+// cpu_usage.h
+// Process CPU and memory usage sampling
+
+#ifndef CPU_USAGE_H
+#define CPU_USAGE_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Total user + system CPU time consumed by this process, in microseconds
+int64_t GetProcessCpuTimeUs();
+
+// Resident set size of this process, in bytes (0 if unavailable)
+int64_t GetProcessRssBytes();
+
+// Processor model string, e.g. from /proc/cpuinfo (empty if unavailable)
+std::string GetCpuModelName();
+
+// Measures process CPU utilization between successive samples
+class ProcessCpuMeter {
+public:
+    ProcessCpuMeter();
+
+    // Fraction of all cores used since the previous call (0.0 - 1.0)
+    double Sample();
+
+    // Same, in cores (e.g. 3.5 = three and a half cores busy)
+    double SampleCores();
+
+    static int NumCores();
+
+private:
+    int64_t last_cpu_us_;
+    std::chrono::steady_clock::time_point last_wall_;
+};
+
+// CPU used by all threads sharing one name since the previous sample
+struct ThreadCpuUsage {
+    std::string name;
+    int threads = 0;
+    double cores = 0;  // 1.0 = one core fully busy
+};
+
+// Per-thread CPU time from /proc/self/task, grouped by thread name.
+// Only available on Linux; elsewhere Sample() returns nothing.
+class ThreadCpuMonitor {
+public:
+    // Busiest names first
+    std::vector<ThreadCpuUsage> Sample();
+
+private:
+    std::map<int, int64_t> last_ticks_;  // tid -> utime + stime in clock ticks
+    std::chrono::steady_clock::time_point last_wall_;
+};
+
+#endif // CPU_USAGE_H
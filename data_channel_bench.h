@@ -0,0 +1,72 @@
+// data_channel_bench.h
+// Streams data channel messages as fast as SCTP flow control allows
+
+#ifndef DATA_CHANNEL_BENCH_H
+#define DATA_CHANNEL_BENCH_H
+
+#include "instrumented_task_queue.h"
+
+#include <api/data_channel_interface.h>
+#include <api/scoped_refptr.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include <atomic>
+#include <cstdint>
+
+struct DataChannelBenchConfig {
+    size_t message_size = 64 * 1024;
+    bool ordered = true;
+    int max_retransmits = -1;                      // -1 = fully reliable
+    uint64_t high_watermark = 4 * 1024 * 1024;     // Stop sending above this bufferedAmount
+    uint64_t low_watermark = 1024 * 1024;          // Resume below this
+
+    // Both sides open the same pre-negotiated channel (see client-cpp.html ?datachannel=1)
+    static constexpr int kChannelId = 1;
+};
+
+// Snapshot since the previous Sample()
+struct DataChannelBenchStats {
+    uint64_t bytes_sent = 0;       // Handed to SCTP
+    uint64_t bytes_acked = 0;      // Echoed back by the client
+    int64_t ack_p50_us = 0;        // Send-to-echo latency
+    int64_t ack_p99_us = 0;
+    double seconds = 0;
+};
+
+// Every message starts with a 16-byte header (sequence number, send time in
+// microseconds). The client echoes the header back, which gives delivered
+// throughput and send-to-ack latency as the application sees it.
+class DataChannelStreamer : public webrtc::DataChannelObserver {
+public:
+    DataChannelStreamer(rtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+                        const DataChannelBenchConfig& config);
+    ~DataChannelStreamer() override;
+
+    // DataChannelObserver implementation (signaling thread)
+    void OnStateChange() override;
+    void OnMessage(const webrtc::DataBuffer& buffer) override;
+    void OnBufferedAmountChange(uint64_t sent_data_size) override;
+
+    DataChannelBenchStats Sample();
+
+    // Bytes queued in SCTP, as of the last send or drain (any thread)
+    uint64_t buffered_amount() const { return buffered_amount_; }
+
+private:
+    // Sends until bufferedAmount reaches the high watermark
+    void Pump();
+
+    rtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    DataChannelBenchConfig config_;
+    rtc::CopyOnWriteBuffer payload_;
+    uint64_t next_sequence_ = 0;
+    bool pumping_ = false;
+
+    std::atomic<uint64_t> bytes_sent_{0};
+    std::atomic<uint64_t> bytes_acked_{0};
+    std::atomic<uint64_t> buffered_amount_{0};
+    LatencyHistogram ack_latency_us_;
+    int64_t last_sample_us_;
+};
+
+#endif // DATA_CHANNEL_BENCH_H
@@ -0,0 +1,93 @@
+// encoded_frame_tap.cpp
+// Implementation of the encoded frame tap
+
+#include "encoded_frame_tap.h"
+
+#include <algorithm>
+#include <chrono>
+
+void EncodedSinkRegistry::Add(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::find(sinks_.begin(), sinks_.end(), sink) == sinks_.end()) {
+        sinks_.push_back(sink);
+    }
+}
+
+void EncodedSinkRegistry::Remove(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+}
+
+bool EncodedSinkRegistry::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sinks_.empty();
+}
+
+void EncodedSinkRegistry::Deliver(const webrtc::RecordableEncodedFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto* sink : sinks_) {
+        sink->OnFrame(frame);
+    }
+}
+
+TappedEncodedFrame::TappedEncodedFrame(rtc::scoped_refptr<webrtc::EncodedImageBuffer> buffer,
+                                       webrtc::VideoCodecType codec,
+                                       bool key_frame,
+                                       EncodedResolution resolution,
+                                       webrtc::Timestamp render_time)
+    : buffer_(std::move(buffer)),
+      codec_(codec),
+      key_frame_(key_frame),
+      resolution_(resolution),
+      render_time_(render_time) {
+}
+
+void EncodedFrameTap::Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) {
+    if (!sinks_.empty()) {
+        auto* video_frame = static_cast<webrtc::TransformableVideoFrameInterface*>(frame.get());
+        webrtc::VideoFrameMetadata metadata = video_frame->GetMetadata();
+        
+        // The only copy of the compressed data; sinks share it by reference
+        rtc::ArrayView<const uint8_t> data = frame->GetData();
+        TappedEncodedFrame tapped_frame(
+            webrtc::EncodedImageBuffer::Create(data.data(), data.size()),
+            metadata.GetCodec(),
+            video_frame->IsKeyFrame(),
+            {static_cast<unsigned>(metadata.GetWidth()), static_cast<unsigned>(metadata.GetHeight())},
+            webrtc::Timestamp::Micros(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count()));
+        
+        sinks_.Deliver(tapped_frame);
+    }
+    
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        auto it = ssrc_callbacks_.find(frame->GetSsrc());
+        callback = it != ssrc_callbacks_.end() ? it->second : callback_;
+    }
+    if (callback) {
+        callback->OnTransformedFrame(std::move(frame));
+    }
+}
+
+void EncodedFrameTap::RegisterTransformedFrameCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = callback;
+}
+
+void EncodedFrameTap::RegisterTransformedFrameSinkCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+                                                           uint32_t ssrc) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    ssrc_callbacks_[ssrc] = callback;
+}
+
+void EncodedFrameTap::UnregisterTransformedFrameCallback() {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = nullptr;
+}
+
+void EncodedFrameTap::UnregisterTransformedFrameSinkCallback(uint32_t ssrc) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    ssrc_callbacks_.erase(ssrc);
+}
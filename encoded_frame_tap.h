@@ -0,0 +1,78 @@
+// encoded_frame_tap.h
+// Taps a sender's compressed output without re-encoding
+
+#ifndef ENCODED_FRAME_TAP_H
+#define ENCODED_FRAME_TAP_H
+
+#include <api/frame_transformer_interface.h>
+#include <api/scoped_refptr.h>
+#include <api/video/encoded_image.h>
+#include <api/video/recordable_encoded_frame.h>
+#include <api/video/video_sink_interface.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Thread-safe list of encoded frame sinks
+class EncodedSinkRegistry {
+public:
+    void Add(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink);
+    void Remove(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink);
+    bool empty() const;
+
+    void Deliver(const webrtc::RecordableEncodedFrame& frame);
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>*> sinks_;
+};
+
+// One compressed frame as it left the encoder
+class TappedEncodedFrame : public webrtc::RecordableEncodedFrame {
+public:
+    TappedEncodedFrame(rtc::scoped_refptr<webrtc::EncodedImageBuffer> buffer,
+                       webrtc::VideoCodecType codec,
+                       bool key_frame,
+                       EncodedResolution resolution,
+                       webrtc::Timestamp render_time);
+
+    rtc::scoped_refptr<const webrtc::EncodedImageBufferInterface> encoded_buffer() const override { return buffer_; }
+    absl::optional<webrtc::ColorSpace> color_space() const override { return absl::nullopt; }
+    webrtc::VideoCodecType codec() const override { return codec_; }
+    bool is_key_frame() const override { return key_frame_; }
+    EncodedResolution resolution() const override { return resolution_; }
+    webrtc::Timestamp render_time() const override { return render_time_; }
+
+private:
+    rtc::scoped_refptr<webrtc::EncodedImageBuffer> buffer_;
+    webrtc::VideoCodecType codec_;
+    bool key_frame_;
+    EncodedResolution resolution_;
+    webrtc::Timestamp render_time_;
+};
+
+// Encoder-to-packetizer frame transformer of one sender that passes every
+// frame through unchanged and hands a copy to its sinks. When nobody listens
+// the only cost is the pass-through.
+class EncodedFrameTap : public webrtc::FrameTransformerInterface {
+public:
+    EncodedSinkRegistry& sinks() { return sinks_; }
+
+    // FrameTransformerInterface implementation (encoder queue)
+    void Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) override;
+    void RegisterTransformedFrameCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) override;
+    void RegisterTransformedFrameSinkCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+                                              uint32_t ssrc) override;
+    void UnregisterTransformedFrameCallback() override;
+    void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override;
+
+private:
+    EncodedSinkRegistry sinks_;
+
+    std::mutex callback_mutex_;
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback_;
+    std::map<uint32_t, rtc::scoped_refptr<webrtc::TransformedFrameCallback>> ssrc_callbacks_;
+};
+
+#endif // ENCODED_FRAME_TAP_H
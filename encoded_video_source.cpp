@@ -7,6 +7,27 @@
 #include <thread>
 #include <chrono>
 
+void FillGradientPattern(webrtc::I420Buffer* buffer) {
+    uint8_t* y_plane = buffer->MutableDataY();
+    uint8_t* u_plane = buffer->MutableDataU();
+    uint8_t* v_plane = buffer->MutableDataV();
+    
+    // Simple gradient pattern
+    for (int y = 0; y < buffer->height(); y++) {
+        for (int x = 0; x < buffer->width(); x++) {
+            y_plane[y * buffer->StrideY() + x] = (x + y) % 256;
+        }
+    }
+    
+    // U and V planes (chroma) - grayscale
+    for (int y = 0; y < buffer->height() / 2; y++) {
+        for (int x = 0; x < buffer->width() / 2; x++) {
+            u_plane[y * buffer->StrideU() + x] = 128;
+            v_plane[y * buffer->StrideV() + x] = 128;
+        }
+    }
+}
+
 EncodedVideoSource::EncodedVideoSource(int width, int height, int fps, int gop_size)
     : width_(width),
       height_(height),
@@ -41,12 +62,13 @@ EncodedVideoSource::~EncodedVideoSource() {
 void EncodedVideoSource::AddOrUpdateSink(
     rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
     const rtc::VideoSinkWants& wants) {
-    broadcaster_.AddOrUpdateSink(sink, wants);
+    broadcaster_.AddOrUpdateSink(delivery_queues_.Wrap(sink), wants);
 }
 
 void EncodedVideoSource::RemoveSink(
     rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
-    broadcaster_.RemoveSink(sink);
+    broadcaster_.RemoveSink(delivery_queues_.Find(sink));
+    delivery_queues_.Remove(sink);
 }
 
 void EncodedVideoSource::EncodeGOP() {
@@ -92,28 +114,14 @@ void EncodedVideoSource::SendFrames() {
         webrtc::I420Buffer::Create(width_, height_);
     
     // Fill with a simple pattern (do this ONCE)
-    uint8_t* y_plane = reusable_buffer->MutableDataY();
-    uint8_t* u_plane = reusable_buffer->MutableDataU();
-    uint8_t* v_plane = reusable_buffer->MutableDataV();
-    
-    // Simple gradient pattern (generated once)
-    for (int y = 0; y < height_; y++) {
-        for (int x = 0; x < width_; x++) {
-            y_plane[y * reusable_buffer->StrideY() + x] = (x + y) % 256;
-        }
-    }
-    
-    // U and V planes (chroma) - grayscale
-    for (int y = 0; y < height_ / 2; y++) {
-        for (int x = 0; x < width_ / 2; x++) {
-            u_plane[y * reusable_buffer->StrideU() + x] = 128;
-            v_plane[y * reusable_buffer->StrideV() + x] = 128;
-        }
-    }
+    FillGradientPattern(reusable_buffer.get());
     
     RTC_LOG(LS_INFO) << "Reusable buffer ready - encoder will process same pixels repeatedly";
     RTC_LOG(LS_INFO) << "This maximizes encoding efficiency (encoder can cache/optimize)";
     
+    // Downscaled copies for adapted senders are made once and reused by all of them
+    rtc::scoped_refptr<PyramidFrameBuffer> pyramid_buffer = PyramidFrameBuffer::Create(reusable_buffer);
+    
     int64_t frame_interval_us = 1000000 / fps_;
     
     while (running_) {
@@ -123,10 +131,16 @@ void EncodedVideoSource::SendFrames() {
         int64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count();
         
-        // Create frame with THE SAME BUFFER (zero copy, just timestamp changes)
+        // Create frame with THE SAME BUFFER (zero copy, just timestamp changes).
+        // Only the first frame has changed pixels; later ones carry an empty
+        // update rect so encoders can tell nothing moved.
+        webrtc::VideoFrame::UpdateRect update_rect = frames_sent_ == 0
+            ? webrtc::VideoFrame::UpdateRect{0, 0, width_, height_}
+            : webrtc::VideoFrame::UpdateRect{0, 0, 0, 0};
         webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
-            .set_video_frame_buffer(reusable_buffer)  // SAME BUFFER EVERY TIME
+            .set_video_frame_buffer(pyramid_buffer)  // SAME BUFFER EVERY TIME
             .set_timestamp_us(timestamp_us)
+            .set_update_rect(update_rect)
             .build();
         
         // Broadcast to all sinks
@@ -4,6 +4,9 @@
 #ifndef ENCODED_VIDEO_SOURCE_H
 #define ENCODED_VIDEO_SOURCE_H
 
+#include "frame_delivery_queue.h"
+#include "frame_pyramid.h"
+
 #include <api/video/video_frame.h>
 #include <api/video/i420_buffer.h>
 #include <api/media_stream_interface.h>
@@ -11,12 +14,15 @@
 #include <modules/video_coding/codecs/vp8/include/vp8.h>
 #include <rtc_base/thread.h>
 #include <rtc_base/ref_counted_object.h>
-#include <media/base/video_broadcaster.h>
 
 #include <atomic>
 #include <memory>
 #include <vector>
 
+// Fills a buffer with the static diagonal gradient (gray chroma) that the
+// source sends in every frame
+void FillGradientPattern(webrtc::I420Buffer* buffer);
+
 // Structure to hold an encoded frame
 struct EncodedFrameData {
     std::vector<uint8_t> data;
@@ -36,7 +42,17 @@ public:
     
     // Get statistics
     int GetFramesSent() const { return frames_sent_; }
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+    int GetFps() const { return fps_; }
+    
+    // Queue frames per sink on their own threads (call before sinks are added)
+    void SetDeliveryQueue(const DeliveryQueueConfig& config) { delivery_queues_.Configure(config); }
+    std::vector<DeliveryQueueStats> GetDeliveryStats() const { return delivery_queues_.GetStats(); }
     size_t GetEncodedGOPSize() const { return encoded_gop_.size(); }
+    
+    // Treat the stream like screen content (call before sessions are created)
+    void SetScreencast(bool screencast) { screencast_ = screencast; }
 
     // VideoSourceInterface implementation
     void AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
@@ -52,11 +68,14 @@ public:
     void UnregisterObserver(webrtc::ObserverInterface* observer) override {}
     
     // VideoTrackSourceInterface implementation
-    bool is_screencast() const override { return false; }
+    bool is_screencast() const override { return screencast_; }
     absl::optional<bool> needs_denoising() const override { return absl::nullopt; }
     bool GetStats(Stats* stats) override { return false; }
     bool SupportsEncodedOutput() const override { return false; }
     void GenerateKeyFrame() override {}
+    
+    // Encoded output is tapped per sender (PeerConnectionHandler::StartRecording):
+    // a source feeds one encoder per viewer, whose streams can't share a sink
     void AddEncodedSink(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) override {}
     void RemoveEncodedSink(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) override {}
     
@@ -84,6 +103,7 @@ private:
     
     std::atomic<bool> running_;
     std::atomic<int> frames_sent_;
+    bool screencast_ = false;
     
     // Pre-encoded GOP
     std::vector<EncodedFrameData> encoded_gop_;
@@ -92,8 +112,11 @@ private:
     // WebRTC thread for frame sending
     std::unique_ptr<rtc::Thread> frame_thread_;
     
-    // Broadcaster to distribute frames to sinks
-    rtc::VideoBroadcaster broadcaster_;
+    // Distributes frames to sinks, each at the resolution its wants ask for
+    AdaptingBroadcaster broadcaster_;
+    
+    // Optional per-sink queues between the broadcaster and the sinks
+    FrameDeliveryQueues delivery_queues_;
     
     // Reference counting
     mutable webrtc::webrtc_impl::RefCounter ref_count_{0};
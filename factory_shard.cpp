@@ -0,0 +1,144 @@
+// factory_shard.cpp
+// Implementation of the factory shard pool
+
+#include "factory_shard.h"
+#include "cpu_usage.h"
+#include "instrumented_task_queue.h"
+#include "simple_audio_factories.h"
+#include "simple_video_factories.h"
+
+#include <api/audio_codecs/builtin_audio_encoder_factory.h>
+#include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <api/call/call_factory_interface.h>
+#include <api/rtc_event_log/rtc_event_log_factory.h>
+#include <api/task_queue/default_task_queue_factory.h>
+#include <api/transport/field_trial_based_config.h>
+#include <media/engine/webrtc_media_engine.h>
+#include <modules/audio_device/include/fake_audio_device.h>
+#include <modules/audio_processing/include/audio_processing.h>
+
+#include <chrono>
+#include <iostream>
+
+FactoryShard::FactoryShard(int index)
+    : index_(index) {
+}
+
+FactoryShard::~FactoryShard() {
+    Stop();
+}
+
+bool FactoryShard::Start(const std::string& thread_suffix, const FactoryOptions& options) {
+    network_thread_ = InstrumentedThread::CreateWithSocketServer("network" + thread_suffix);
+    network_thread_->Start();
+    
+    worker_thread_ = InstrumentedThread::Create("worker" + thread_suffix);
+    worker_thread_->Start();
+    
+    signaling_thread_ = InstrumentedThread::Create("signaling" + thread_suffix);
+    signaling_thread_->Start();
+    
+    // Same setup as webrtc::CreatePeerConnectionFactory, except that every
+    // task queue (encoders, pacer, ...) comes from the instrumented factory
+    webrtc::PeerConnectionFactoryDependencies dependencies;
+    dependencies.network_thread = network_thread_.get();
+    dependencies.worker_thread = worker_thread_.get();
+    dependencies.signaling_thread = signaling_thread_.get();
+    dependencies.socket_factory = network_thread_->socketserver();
+    dependencies.task_queue_factory =
+        std::make_unique<InstrumentedTaskQueueFactory>(webrtc::CreateDefaultTaskQueueFactory(),
+                                                       options.task_queue_prefix);
+    dependencies.call_factory = webrtc::CreateCallFactory();
+    dependencies.event_log_factory =
+        std::make_unique<webrtc::RtcEventLogFactory>(dependencies.task_queue_factory.get());
+    dependencies.trials = std::make_unique<webrtc::FieldTrialBasedConfig>();
+    
+    // Media engine with simple custom video factories
+    cricket::MediaEngineDependencies media_dependencies;
+    media_dependencies.task_queue_factory = dependencies.task_queue_factory.get();
+    if (options.video_only) {
+        // Without an ADM libwebrtc would open the platform audio device
+        media_dependencies.adm = rtc::make_ref_counted<webrtc::FakeAudioDeviceModule>();
+        media_dependencies.audio_encoder_factory = rtc::make_ref_counted<webrtc::EmptyAudioEncoderFactory>();
+        media_dependencies.audio_decoder_factory = rtc::make_ref_counted<webrtc::EmptyAudioDecoderFactory>();
+    } else {
+        media_dependencies.audio_encoder_factory = webrtc::CreateBuiltinAudioEncoderFactory();
+        media_dependencies.audio_decoder_factory = webrtc::CreateBuiltinAudioDecoderFactory();
+        media_dependencies.audio_processing = webrtc::AudioProcessingBuilder().Create();
+    }
+    media_dependencies.video_encoder_factory = std::make_unique<webrtc::SimpleVideoEncoderFactory>(options.skip_unchanged_frames);
+    if (options.decode_video) {
+        media_dependencies.video_decoder_factory = std::make_unique<webrtc::SimpleVideoDecoderFactory>();
+    } else {
+        media_dependencies.video_decoder_factory = std::make_unique<webrtc::NullVideoDecoderFactory>();
+    }
+    media_dependencies.trials = dependencies.trials.get();
+    dependencies.media_engine = cricket::CreateMediaEngine(std::move(media_dependencies));
+    
+    factory_ = webrtc::CreateModularPeerConnectionFactory(std::move(dependencies));
+    
+    return factory_ != nullptr;
+}
+
+void FactoryShard::Stop() {
+    factory_ = nullptr;
+    
+    if (signaling_thread_) signaling_thread_->Stop();
+    if (worker_thread_) worker_thread_->Stop();
+    if (network_thread_) network_thread_->Stop();
+    
+    signaling_thread_.reset();
+    worker_thread_.reset();
+    network_thread_.reset();
+}
+
+FactoryShardPool::~FactoryShardPool() {
+    Stop();
+}
+
+bool FactoryShardPool::Start(int num_shards, const FactoryOptions& options) {
+    for (int i = 0; i < num_shards; i++) {
+        auto shard = std::make_unique<FactoryShard>(i);
+        // A single shard keeps the plain thread names
+        std::string suffix = num_shards > 1 ? "-" + std::to_string(i) : "";
+        
+        auto start_time = std::chrono::steady_clock::now();
+        int64_t rss_before = GetProcessRssBytes();
+        if (!shard->Start(suffix, options)) {
+            std::cerr << "Failed to create peer connection factory for shard " << i << std::endl;
+            Stop();
+            return false;
+        }
+        auto startup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+        std::cout << "Factory " << i << (options.video_only ? " (video-only)" : "") << ": started in "
+                  << startup_ms << " ms, +" << (GetProcessRssBytes() - rss_before) / 1024 << " KB RSS\n";
+        
+        shards_.push_back(std::move(shard));
+    }
+    return true;
+}
+
+void FactoryShardPool::Stop() {
+    // Factories are released before their threads in each shard
+    shards_.clear();
+}
+
+FactoryShard* FactoryShardPool::Acquire() {
+    FactoryShard* best = nullptr;
+    for (auto& shard : shards_) {
+        if (!best || shard->session_count_ < best->session_count_) {
+            best = shard.get();
+        }
+    }
+    if (best) {
+        best->session_count_++;
+    }
+    return best;
+}
+
+void FactoryShardPool::Release(FactoryShard* shard) {
+    if (shard) {
+        shard->session_count_--;
+    }
+}
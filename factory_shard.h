@@ -0,0 +1,84 @@
+// factory_shard.h
+// Pool of independent PeerConnectionFactory instances, each on its own threads
+
+#ifndef FACTORY_SHARD_H
+#define FACTORY_SHARD_H
+
+#include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
+#include <rtc_base/thread.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FactoryOptions {
+    // Dummy audio device, no audio processing and no audio codecs
+    bool video_only = false;
+    // Decode received video; false swaps in a decoder that discards frames
+    bool decode_video = true;
+    // Don't encode frames whose update_rect is empty (static content)
+    bool skip_unchanged_frames = false;
+    // Prepended to the names of the factory's task queue threads (encoder,
+    // decoder, pacer, ...), which Start's thread_suffix doesn't reach. A
+    // prefix because Linux truncates thread names to 15 characters.
+    std::string task_queue_prefix;
+};
+
+// One factory with its own network, worker and signaling threads. All RTP
+// packetization, pacing, SRTP and ICE of its sessions run on these threads.
+class FactoryShard {
+public:
+    explicit FactoryShard(int index);
+    ~FactoryShard();
+
+    // Starts the threads and creates the factory. thread_suffix is appended
+    // to the thread names ("network" + "-2").
+    bool Start(const std::string& thread_suffix, const FactoryOptions& options);
+    void Stop();
+
+    int index() const { return index_; }
+    int session_count() const { return session_count_; }
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory() const { return factory_; }
+
+    rtc::Thread* network_thread() const { return network_thread_.get(); }
+    rtc::Thread* worker_thread() const { return worker_thread_.get(); }
+    rtc::Thread* signaling_thread() const { return signaling_thread_.get(); }
+
+private:
+    friend class FactoryShardPool;
+
+    int index_;
+    std::atomic<int> session_count_{0};
+
+    std::unique_ptr<rtc::Thread> network_thread_;
+    std::unique_ptr<rtc::Thread> worker_thread_;
+    std::unique_ptr<rtc::Thread> signaling_thread_;
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
+};
+
+// Assigns every new session to the shard with the fewest live sessions.
+// With one shard this is the original single-factory setup. Acquire and
+// Release must be serialized by the caller (the server's session lock).
+class FactoryShardPool {
+public:
+    FactoryShardPool() = default;
+    ~FactoryShardPool();
+
+    bool Start(int num_shards, const FactoryOptions& options = FactoryOptions());
+    void Stop();
+
+    // Picks the least-loaded shard and counts a session against it.
+    // Returns nullptr when the pool is not running.
+    FactoryShard* Acquire();
+    void Release(FactoryShard* shard);
+
+    size_t size() const { return shards_.size(); }
+    const std::vector<std::unique_ptr<FactoryShard>>& shards() const { return shards_; }
+
+private:
+    std::vector<std::unique_ptr<FactoryShard>> shards_;
+};
+
+#endif // FACTORY_SHARD_H
@@ -0,0 +1,127 @@
+// frame_delivery_queue.cpp
+// Implementation of per-sink frame delivery queues
+
+#include "frame_delivery_queue.h"
+
+#include <algorithm>
+
+QueuedVideoSink::QueuedVideoSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
+                                 const DeliveryQueueConfig& config, const std::string& thread_name)
+    : sink_(sink),
+      ring_(std::max<size_t>(config.depth, 1)) {
+    thread_ = rtc::Thread::Create();
+    thread_->SetName(thread_name, nullptr);
+    thread_->Start();
+}
+
+QueuedVideoSink::~QueuedVideoSink() {
+    // Joins the thread; a pending Drain() task is discarded with it
+    thread_->Stop();
+}
+
+void QueuedVideoSink::OnFrame(const webrtc::VideoFrame& frame) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == ring_.size()) {
+            // Full: evict the oldest
+            ring_[head_].reset();
+            head_ = (head_ + 1) % ring_.size();
+            count_--;
+            frames_dropped_++;
+        }
+        ring_[(head_ + count_) % ring_.size()] = frame;
+        count_++;
+        frames_queued_++;
+
+        if (!drain_scheduled_) {
+            drain_scheduled_ = true;
+            schedule = true;
+        }
+    }
+
+    if (schedule) {
+        thread_->PostTask([this]() { Drain(); });
+    }
+}
+
+void QueuedVideoSink::Drain() {
+    while (true) {
+        absl::optional<webrtc::VideoFrame> frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count_ == 0) {
+                drain_scheduled_ = false;
+                return;
+            }
+            frame = std::move(ring_[head_]);
+            ring_[head_].reset();
+            head_ = (head_ + 1) % ring_.size();
+            count_--;
+        }
+
+        // Outside the lock: this is the call that may be slow
+        sink_->OnFrame(*frame);
+        frames_delivered_++;
+    }
+}
+
+DeliveryQueueStats QueuedVideoSink::GetStats() const {
+    DeliveryQueueStats stats;
+    stats.frames_queued = frames_queued_;
+    stats.frames_delivered = frames_delivered_;
+    stats.frames_dropped = frames_dropped_;
+    return stats;
+}
+
+rtc::VideoSinkInterface<webrtc::VideoFrame>* FrameDeliveryQueues::Wrap(
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
+    if (!config_.enabled) {
+        return sink;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = queues_.find(sink);
+    if (it == queues_.end()) {
+        uint64_t id = next_id_++;
+        auto queue = std::make_unique<QueuedVideoSink>(sink, config_, "FrameDelivery");
+        it = queues_.emplace(sink, std::make_pair(id, std::move(queue))).first;
+    }
+    return it->second.second.get();
+}
+
+rtc::VideoSinkInterface<webrtc::VideoFrame>* FrameDeliveryQueues::Find(
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = queues_.find(sink);
+    return it != queues_.end() ? it->second.second.get() : sink;
+}
+
+void FrameDeliveryQueues::Remove(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
+    std::unique_ptr<QueuedVideoSink> queue;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = queues_.find(sink);
+        if (it == queues_.end()) return;
+        queue = std::move(it->second.second);
+        queues_.erase(it);
+    }
+    // Joined outside the lock so a slow sink doesn't hold up the others
+    queue.reset();
+}
+
+std::vector<DeliveryQueueStats> FrameDeliveryQueues::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<uint64_t, DeliveryQueueStats>> ordered;
+    for (const auto& [sink, entry] : queues_) {
+        ordered.emplace_back(entry.first, entry.second->GetStats());
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<DeliveryQueueStats> stats;
+    for (const auto& [id, entry_stats] : ordered) {
+        stats.push_back(entry_stats);
+    }
+    return stats;
+}
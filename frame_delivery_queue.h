@@ -0,0 +1,97 @@
+// frame_delivery_queue.h
+// Per-sink frame queues that decouple a source's generator thread from
+// slow encoders
+
+#ifndef FRAME_DELIVERY_QUEUE_H
+#define FRAME_DELIVERY_QUEUE_H
+
+#include <absl/types/optional.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_sink_interface.h>
+#include <rtc_base/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A full queue evicts its oldest frame; depth 1 only ever holds the newest
+// frame (lowest latency)
+struct DeliveryQueueConfig {
+    bool enabled = false;
+    size_t depth = 3;
+};
+
+struct DeliveryQueueStats {
+    uint64_t frames_queued = 0;
+    uint64_t frames_delivered = 0;
+    uint64_t frames_dropped = 0;
+};
+
+// Sink wrapper with its own ring of frames and its own delivery thread.
+// OnFrame never blocks on the wrapped sink: when the sink falls behind,
+// the oldest frames are dropped and counted, so the generator (and
+// every other sink) keeps its frame rate.
+class QueuedVideoSink : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
+public:
+    QueuedVideoSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const DeliveryQueueConfig& config,
+                    const std::string& thread_name);
+    // Stops the delivery thread; frames still queued are discarded
+    ~QueuedVideoSink() override;
+
+    // VideoSinkInterface implementation (generator thread)
+    void OnFrame(const webrtc::VideoFrame& frame) override;
+
+    DeliveryQueueStats GetStats() const;
+
+private:
+    // Delivers queued frames until the ring is empty (delivery thread)
+    void Drain();
+
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* sink_;
+
+    mutable std::mutex mutex_;
+    std::vector<absl::optional<webrtc::VideoFrame>> ring_;
+    size_t head_ = 0;   // Oldest queued frame
+    size_t count_ = 0;
+    bool drain_scheduled_ = false;
+
+    std::atomic<uint64_t> frames_queued_{0};
+    std::atomic<uint64_t> frames_delivered_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+
+    std::unique_ptr<rtc::Thread> thread_;
+};
+
+// Owns one QueuedVideoSink per downstream sink. Sources register Wrap(sink)
+// with their broadcaster instead of the sink itself; when disabled, Wrap
+// and Find return the sink unchanged and nothing is queued.
+class FrameDeliveryQueues {
+public:
+    void Configure(const DeliveryQueueConfig& config) { config_ = config; }
+    bool enabled() const { return config_.enabled; }
+
+    // The sink to hand to the broadcaster (created on first use)
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* Wrap(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink);
+
+    // The sink currently registered with the broadcaster for sink
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* Find(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink);
+
+    // Destroys sink's queue; call after removing it from the broadcaster
+    void Remove(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink);
+
+    // One entry per live sink, in registration order
+    std::vector<DeliveryQueueStats> GetStats() const;
+
+private:
+    DeliveryQueueConfig config_;
+    mutable std::mutex mutex_;
+    uint64_t next_id_ = 0;
+    // Keyed by sink; the id keeps GetStats() in registration order
+    std::map<rtc::VideoSinkInterface<webrtc::VideoFrame>*, std::pair<uint64_t, std::unique_ptr<QueuedVideoSink>>> queues_;
+};
+
+#endif // FRAME_DELIVERY_QUEUE_H
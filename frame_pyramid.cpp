@@ -0,0 +1,125 @@
+// frame_pyramid.cpp
+// Implementation of the frame pyramid and the adapting broadcaster
+
+#include "frame_pyramid.h"
+
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+
+std::atomic<uint64_t> PyramidFrameBuffer::scale_requests_{0};
+std::atomic<uint64_t> PyramidFrameBuffer::scales_computed_{0};
+
+rtc::scoped_refptr<PyramidFrameBuffer> PyramidFrameBuffer::Create(
+    rtc::scoped_refptr<webrtc::I420BufferInterface> base) {
+    return rtc::make_ref_counted<PyramidFrameBuffer>(std::move(base));
+}
+
+PyramidFrameBuffer::PyramidFrameBuffer(rtc::scoped_refptr<webrtc::I420BufferInterface> base)
+    : base_(std::move(base)) {
+}
+
+rtc::scoped_refptr<webrtc::VideoFrameBuffer> PyramidFrameBuffer::CropAndScale(
+    int offset_x, int offset_y, int crop_width, int crop_height, int scaled_width, int scaled_height) {
+    scale_requests_++;
+    
+    bool full_frame = offset_x == 0 && offset_y == 0 && crop_width == width() && crop_height == height();
+    if (full_frame && scaled_width == width() && scaled_height == height()) {
+        return rtc::scoped_refptr<webrtc::VideoFrameBuffer>(this);
+    }
+    
+    Key key(offset_x, offset_y, crop_width, crop_height, scaled_width, scaled_height);
+    std::shared_ptr<Variant> variant;
+    rtc::scoped_refptr<webrtc::I420Buffer> pyramid_source;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = variants_.find(key);
+        if (it == variants_.end()) {
+            if (variants_.size() >= kMaxVariants) {
+                variants_.clear();  // Targets changed a lot; start over
+            }
+            it = variants_.emplace(key, std::make_shared<Variant>()).first;
+        }
+        variant = it->second;
+        
+        // Smallest finished full-frame variant that still covers the target
+        if (full_frame) {
+            for (auto& [other_key, other] : variants_) {
+                const auto& [ox, oy, cw, ch, sw, sh] = other_key;
+                bool other_full = ox == 0 && oy == 0 && cw == width() && ch == height();
+                if (other_full && other->buffer && sw >= scaled_width && sh >= scaled_height &&
+                    (!pyramid_source || sw < pyramid_source->width())) {
+                    pyramid_source = other->buffer;
+                }
+            }
+        }
+    }
+    
+    // Concurrent requests for the same target wait for one computation
+    std::call_once(variant->computed, [&]() {
+        rtc::scoped_refptr<webrtc::I420Buffer> scaled = webrtc::I420Buffer::Create(scaled_width, scaled_height);
+        if (pyramid_source) {
+            scaled->ScaleFrom(*pyramid_source);
+        } else {
+            scaled->CropAndScaleFrom(*base_, offset_x, offset_y, crop_width, crop_height);
+        }
+        scales_computed_++;
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        variant->buffer = scaled;
+    });
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    return variant->buffer;
+}
+
+void AdaptingBroadcaster::AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
+                                          const rtc::VideoSinkWants& wants) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(sinks_.begin(), sinks_.end(),
+                           [sink](const SinkState& state) { return state.sink == sink; });
+    if (it == sinks_.end()) {
+        sinks_.push_back({sink, std::make_unique<cricket::VideoAdapter>()});
+        it = sinks_.end() - 1;
+    }
+    it->adapter->OnSinkWants(wants);
+}
+
+void AdaptingBroadcaster::RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sinks_.erase(std::remove_if(sinks_.begin(), sinks_.end(),
+                                [sink](const SinkState& state) { return state.sink == sink; }),
+                 sinks_.end());
+}
+
+void AdaptingBroadcaster::OnFrame(const webrtc::VideoFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t time_ns = frame.timestamp_us() * rtc::kNumNanosecsPerMicrosec;
+    
+    for (SinkState& state : sinks_) {
+        int cropped_width, cropped_height, out_width, out_height;
+        if (!state.adapter->AdaptFrameResolution(frame.width(), frame.height(), time_ns,
+                                                 &cropped_width, &cropped_height, &out_width, &out_height)) {
+            continue;  // Dropped to honor the sink's max frame rate
+        }
+        
+        if (out_width == frame.width() && out_height == frame.height()) {
+            state.sink->OnFrame(frame);
+            continue;
+        }
+        
+        int offset_x = (frame.width() - cropped_width) / 2;
+        int offset_y = (frame.height() - cropped_height) / 2;
+        webrtc::VideoFrame adapted = frame;
+        adapted.set_video_frame_buffer(frame.video_frame_buffer()->CropAndScale(
+            offset_x, offset_y, cropped_width, cropped_height, out_width, out_height));
+        if (frame.has_update_rect()) {
+            // Keep the dirty region in the adapted frame's coordinates
+            adapted.set_update_rect(frame.update_rect().ScaleWithFrame(
+                frame.width(), frame.height(), offset_x, offset_y,
+                cropped_width, cropped_height, out_width, out_height));
+        }
+        state.sink->OnFrame(adapted);
+    }
+}
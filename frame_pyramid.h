@@ -0,0 +1,94 @@
+// frame_pyramid.h
+// Frame buffer that caches its downscaled variants, and a broadcaster that
+// delivers each sink the resolution it asked for
+
+#ifndef FRAME_PYRAMID_H
+#define FRAME_PYRAMID_H
+
+#include <api/scoped_refptr.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_frame_buffer.h>
+#include <api/video/video_sink_interface.h>
+#include <api/video/video_source_interface.h>
+#include <media/base/video_adapter.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// I420 buffer whose CropAndScale() (and so Scale()) results are computed
+// once and shared: every encoder asking for the same target gets the same
+// scaled buffer. Scale-only targets are made from the smallest cached
+// variant that is still large enough, so 1/4 comes from 1/2, not from 4K.
+// Sources that reuse one buffer for every frame keep the cache warm forever.
+class PyramidFrameBuffer : public webrtc::I420BufferInterface {
+public:
+    static rtc::scoped_refptr<PyramidFrameBuffer> Create(rtc::scoped_refptr<webrtc::I420BufferInterface> base);
+
+    // I420BufferInterface implementation
+    int width() const override { return base_->width(); }
+    int height() const override { return base_->height(); }
+    const uint8_t* DataY() const override { return base_->DataY(); }
+    const uint8_t* DataU() const override { return base_->DataU(); }
+    const uint8_t* DataV() const override { return base_->DataV(); }
+    int StrideY() const override { return base_->StrideY(); }
+    int StrideU() const override { return base_->StrideU(); }
+    int StrideV() const override { return base_->StrideV(); }
+
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> CropAndScale(int offset_x, int offset_y,
+                                                              int crop_width, int crop_height,
+                                                              int scaled_width, int scaled_height) override;
+
+    // Process-wide counters: scales requested vs. actually computed
+    static uint64_t ScaleRequests() { return scale_requests_; }
+    static uint64_t ScalesComputed() { return scales_computed_; }
+
+protected:
+    explicit PyramidFrameBuffer(rtc::scoped_refptr<webrtc::I420BufferInterface> base);
+
+private:
+    // (offset_x, offset_y, crop_width, crop_height, scaled_width, scaled_height)
+    using Key = std::tuple<int, int, int, int, int, int>;
+
+    struct Variant {
+        std::once_flag computed;
+        rtc::scoped_refptr<webrtc::I420Buffer> buffer;
+    };
+
+    static constexpr size_t kMaxVariants = 16;
+
+    rtc::scoped_refptr<webrtc::I420BufferInterface> base_;
+    std::mutex mutex_;
+    std::map<Key, std::shared_ptr<Variant>> variants_;
+
+    static std::atomic<uint64_t> scale_requests_;
+    static std::atomic<uint64_t> scales_computed_;
+};
+
+// Replaces rtc::VideoBroadcaster for sources feeding many senders. Each sink
+// gets its own cricket::VideoAdapter driven by its VideoSinkWants (CPU and
+// bandwidth adaptation), and the adapted frame is cut from the source
+// buffer with CropAndScale, which a PyramidFrameBuffer shares between sinks.
+class AdaptingBroadcaster : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
+public:
+    void AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const rtc::VideoSinkWants& wants);
+    void RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink);
+
+    // VideoSinkInterface implementation
+    void OnFrame(const webrtc::VideoFrame& frame) override;
+
+private:
+    struct SinkState {
+        rtc::VideoSinkInterface<webrtc::VideoFrame>* sink;
+        std::unique_ptr<cricket::VideoAdapter> adapter;
+    };
+
+    std::mutex mutex_;
+    std::vector<SinkState> sinks_;
+};
+
+#endif // FRAME_PYRAMID_H
@@ -0,0 +1,211 @@
+// instrumented_task_queue.cpp
+// Implementation of the instrumented task queues
+
+#include "instrumented_task_queue.h"
+
+#include <rtc_base/null_socket_server.h>
+#include <rtc_base/socket_server.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Forwards to a queue from the default factory, instrumenting each task.
+// Tasks run with this wrapper as TaskQueueBase::Current(), so IsCurrent()
+// checks against the queue handed out by the factory keep working.
+class InstrumentedTaskQueue : public webrtc::TaskQueueBase {
+public:
+    InstrumentedTaskQueue(std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter> base,
+                          std::shared_ptr<TaskQueueMetrics> metrics)
+        : base_(std::move(base)),
+          metrics_(std::move(metrics)),
+          backlog_(std::make_shared<TaskQueueBacklog>()) {
+        metrics_->queues++;
+    }
+
+    void Delete() override {
+        // Stops the underlying thread; pending tasks are dropped
+        base_.reset();
+        metrics_->queues--;
+        delete this;
+    }
+
+    void PostTask(absl::AnyInvocable<void() &&> task) override {
+        base_->PostTask(Wrap(std::move(task), 0));
+    }
+
+    void PostDelayedTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) override {
+        base_->PostDelayedTask(Wrap(std::move(task), delay.us()), delay);
+    }
+
+    void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) override {
+        base_->PostDelayedHighPrecisionTask(Wrap(std::move(task), delay.us()), delay);
+    }
+
+private:
+    absl::AnyInvocable<void() &&> Wrap(absl::AnyInvocable<void() &&> task, int64_t delay_us) {
+        return [this, task = InstrumentTask(std::move(task), metrics_, backlog_, delay_us)]() mutable {
+            CurrentTaskQueueSetter set_current(this);
+            std::move(task)();
+        };
+    }
+
+    std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter> base_;
+    std::shared_ptr<TaskQueueMetrics> metrics_;
+    std::shared_ptr<TaskQueueBacklog> backlog_;
+};
+
+} // namespace
+
+void LatencyHistogram::Record(int64_t us) {
+    int bucket = 0;
+    while (us > 0 && bucket < kBuckets - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::Percentile(const std::vector<uint64_t>& counts, double fraction) const {
+    uint64_t total = 0;
+    for (uint64_t count : counts) total += count;
+    if (total == 0) return 0;
+    
+    uint64_t target = static_cast<uint64_t>(total * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += counts[i];
+        if (seen > target) {
+            return i == 0 ? 0 : (int64_t{1} << i) - 1;
+        }
+    }
+    return (int64_t{1} << (kBuckets - 1)) - 1;
+}
+
+std::vector<uint64_t> LatencyHistogram::Drain() {
+    std::vector<uint64_t> counts(kBuckets);
+    for (int i = 0; i < kBuckets; i++) {
+        counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+TaskQueueMetricsRegistry& TaskQueueMetricsRegistry::Instance() {
+    static TaskQueueMetricsRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<TaskQueueMetrics> TaskQueueMetricsRegistry::Get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& metrics = metrics_[name];
+    if (!metrics) {
+        metrics = std::make_shared<TaskQueueMetrics>();
+        metrics->name = name;
+    }
+    return metrics;
+}
+
+std::vector<TaskQueueReport> TaskQueueMetricsRegistry::Report() {
+    std::vector<TaskQueueReport> reports;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [name, metrics] : metrics_) {
+        std::vector<uint64_t> delay = metrics->delay_us.Drain();
+        std::vector<uint64_t> run = metrics->run_us.Drain();
+        
+        TaskQueueReport report;
+        report.name = name;
+        report.queues = metrics->queues;
+        for (uint64_t count : run) report.tasks += count;
+        report.delay_p50_us = metrics->delay_us.Percentile(delay, 0.50);
+        report.delay_p99_us = metrics->delay_us.Percentile(delay, 0.99);
+        report.run_p50_us = metrics->run_us.Percentile(run, 0.50);
+        report.run_p99_us = metrics->run_us.Percentile(run, 0.99);
+        report.max_depth = metrics->max_depth.exchange(0);
+        report.max_delayed = metrics->max_delayed.exchange(0);
+        if (report.tasks > 0) {
+            reports.push_back(report);
+        }
+    }
+    std::sort(reports.begin(), reports.end(), [](const TaskQueueReport& a, const TaskQueueReport& b) {
+        return a.delay_p99_us > b.delay_p99_us;
+    });
+    return reports;
+}
+
+absl::AnyInvocable<void() &&> InstrumentTask(absl::AnyInvocable<void() &&> task,
+                                             std::shared_ptr<TaskQueueMetrics> metrics,
+                                             std::shared_ptr<TaskQueueBacklog> backlog,
+                                             int64_t delay_us) {
+    bool delayed = delay_us > 0;
+    std::atomic<int>& pending = delayed ? backlog->delayed : backlog->ready;
+    std::atomic<int>& max_pending = delayed ? metrics->max_delayed : metrics->max_depth;
+    int count = ++pending;
+    int max_count = max_pending.load(std::memory_order_relaxed);
+    while (count > max_count && !max_pending.compare_exchange_weak(max_count, count)) {
+    }
+    
+    // Delayed tasks are measured from when they became due
+    int64_t due_us = NowUs() + delay_us;
+    return [task = std::move(task), metrics = std::move(metrics), backlog = std::move(backlog), delayed,
+            due_us]() mutable {
+        int64_t start_us = NowUs();
+        metrics->delay_us.Record(std::max<int64_t>(0, start_us - due_us));
+        --(delayed ? backlog->delayed : backlog->ready);
+        std::move(task)();
+        metrics->run_us.Record(NowUs() - start_us);
+    };
+}
+
+InstrumentedTaskQueueFactory::InstrumentedTaskQueueFactory(std::unique_ptr<webrtc::TaskQueueFactory> base,
+                                                           const std::string& name_prefix)
+    : base_(std::move(base)),
+      name_prefix_(name_prefix) {
+}
+
+std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter>
+InstrumentedTaskQueueFactory::CreateTaskQueue(absl::string_view name, Priority priority) const {
+    std::string full_name = name_prefix_ + std::string(name);
+    auto metrics = TaskQueueMetricsRegistry::Instance().Get(full_name);
+    return std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter>(
+        new InstrumentedTaskQueue(base_->CreateTaskQueue(full_name, priority), std::move(metrics)));
+}
+
+std::unique_ptr<rtc::Thread> InstrumentedThread::Create(const std::string& name) {
+    return std::make_unique<InstrumentedThread>(std::make_unique<rtc::NullSocketServer>(), name);
+}
+
+std::unique_ptr<rtc::Thread> InstrumentedThread::CreateWithSocketServer(const std::string& name) {
+    return std::make_unique<InstrumentedThread>(rtc::CreateDefaultSocketServer(), name);
+}
+
+InstrumentedThread::InstrumentedThread(std::unique_ptr<rtc::SocketServer> socket_server, const std::string& name)
+    : rtc::Thread(std::move(socket_server)),
+      metrics_(TaskQueueMetricsRegistry::Instance().Get(name)),
+      backlog_(std::make_shared<TaskQueueBacklog>()) {
+    SetName(name, nullptr);
+    metrics_->queues++;
+}
+
+InstrumentedThread::~InstrumentedThread() {
+    // Must stop before the members used by posted tasks go away
+    Stop();
+    metrics_->queues--;
+}
+
+void InstrumentedThread::PostTask(absl::AnyInvocable<void() &&> task) {
+    rtc::Thread::PostTask(InstrumentTask(std::move(task), metrics_, backlog_, 0));
+}
+
+void InstrumentedThread::PostDelayedTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) {
+    rtc::Thread::PostDelayedTask(InstrumentTask(std::move(task), metrics_, backlog_, delay.us()), delay);
+}
+
+void InstrumentedThread::PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) {
+    rtc::Thread::PostDelayedHighPrecisionTask(InstrumentTask(std::move(task), metrics_, backlog_, delay.us()), delay);
+}
@@ -0,0 +1,130 @@
+// instrumented_task_queue.h
+// Task queues and threads that record queueing delay, run time and backlog
+
+#ifndef INSTRUMENTED_TASK_QUEUE_H
+#define INSTRUMENTED_TASK_QUEUE_H
+
+#include <api/task_queue/task_queue_base.h>
+#include <api/task_queue/task_queue_factory.h>
+#include <rtc_base/thread.h>
+
+#include <absl/functional/any_invocable.h>
+#include <absl/strings/string_view.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Lock-free histogram with power-of-two microsecond buckets
+// (bucket i holds values in [2^(i-1), 2^i) us, bucket 0 holds 0 us)
+class LatencyHistogram {
+public:
+    static constexpr int kBuckets = 32;
+
+    void Record(int64_t us);
+
+    // Approximate percentile (upper bound of the bucket), in microseconds
+    int64_t Percentile(const std::vector<uint64_t>& counts, double fraction) const;
+
+    // Moves the counts out, leaving the histogram empty
+    std::vector<uint64_t> Drain();
+
+private:
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+};
+
+// Metrics shared by every queue with the same name (all "EncoderQueue"s
+// together, for example)
+struct TaskQueueMetrics {
+    std::string name;
+    std::atomic<int> queues{0};
+    std::atomic<int> max_depth{0};    // Highest backlog of ready tasks since the last report
+    std::atomic<int> max_delayed{0};  // Most delayed tasks waiting for their time
+    LatencyHistogram delay_us;        // Enqueue (or due time) to start
+    LatencyHistogram run_us;          // Start to end
+};
+
+// Tasks posted to one queue and not yet started. Delayed tasks (pacer,
+// periodic timers) are kept apart so their future work doesn't look like
+// a backlog; once due, their wait shows in delay_us.
+struct TaskQueueBacklog {
+    std::atomic<int> ready{0};
+    std::atomic<int> delayed{0};
+};
+
+// Summary of one queue name over one reporting interval
+struct TaskQueueReport {
+    std::string name;
+    int queues = 0;
+    uint64_t tasks = 0;
+    int64_t delay_p50_us = 0;
+    int64_t delay_p99_us = 0;
+    int64_t run_p50_us = 0;
+    int64_t run_p99_us = 0;
+    int max_depth = 0;
+    int max_delayed = 0;
+};
+
+// Process-wide registry of queue metrics, keyed by queue name
+class TaskQueueMetricsRegistry {
+public:
+    static TaskQueueMetricsRegistry& Instance();
+
+    std::shared_ptr<TaskQueueMetrics> Get(const std::string& name);
+
+    // Drains every histogram; busiest queues (by p99 delay) first
+    std::vector<TaskQueueReport> Report();
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<TaskQueueMetrics>> metrics_;
+};
+
+// Wraps a task so that it records its delay and run time when it runs.
+// backlog belongs to the queue the task was posted to.
+absl::AnyInvocable<void() &&> InstrumentTask(absl::AnyInvocable<void() &&> task,
+                                             std::shared_ptr<TaskQueueMetrics> metrics,
+                                             std::shared_ptr<TaskQueueBacklog> backlog,
+                                             int64_t delay_us);
+
+// Wraps every queue created by the default factory (encoder queues, pacer,
+// RTP transport controller, ...). name_prefix is prepended to each queue's
+// (and so its thread's) name.
+class InstrumentedTaskQueueFactory : public webrtc::TaskQueueFactory {
+public:
+    explicit InstrumentedTaskQueueFactory(std::unique_ptr<webrtc::TaskQueueFactory> base,
+                                          const std::string& name_prefix = "");
+
+    std::unique_ptr<webrtc::TaskQueueBase, webrtc::TaskQueueDeleter> CreateTaskQueue(
+        absl::string_view name, Priority priority) const override;
+
+private:
+    std::unique_ptr<webrtc::TaskQueueFactory> base_;
+    std::string name_prefix_;
+};
+
+// rtc::Thread that instruments tasks posted to it. Used for the network,
+// worker and signaling threads, which are not created by a TaskQueueFactory.
+// Synchronous BlockingCall()s bypass the task queue and are not recorded.
+class InstrumentedThread : public rtc::Thread {
+public:
+    static std::unique_ptr<rtc::Thread> Create(const std::string& name);
+    static std::unique_ptr<rtc::Thread> CreateWithSocketServer(const std::string& name);
+
+    InstrumentedThread(std::unique_ptr<rtc::SocketServer> socket_server, const std::string& name);
+    ~InstrumentedThread() override;
+
+    void PostTask(absl::AnyInvocable<void() &&> task) override;
+    void PostDelayedTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) override;
+    void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, webrtc::TimeDelta delay) override;
+
+private:
+    std::shared_ptr<TaskQueueMetrics> metrics_;
+    std::shared_ptr<TaskQueueBacklog> backlog_;
+};
+
+#endif // INSTRUMENTED_TASK_QUEUE_H
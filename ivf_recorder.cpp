@@ -0,0 +1,203 @@
+// ivf_recorder.cpp
+// Implementation of the IVF recorder
+
+#include "ivf_recorder.h"
+#include "async_logger.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const size_t kIvfFrameHeaderSize = 12;
+const size_t kWriteChunkSize = 4 * 1024 * 1024;
+
+void PutLe16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+void PutLe32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+void PutLe64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+} // namespace
+
+IvfRecorder::IvfRecorder(size_t max_queued_bytes)
+    : max_queued_bytes_(max_queued_bytes) {
+}
+
+IvfRecorder::~IvfRecorder() {
+    Close();
+}
+
+bool IvfRecorder::Open(const std::string& path) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        std::cerr << "Failed to open recording " << path << std::endl;
+        return false;
+    }
+    // Our own staging buffer does the batching
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+    
+    path_ = path;
+    staging_.reserve(kWriteChunkSize + kIvfFrameHeaderSize);
+    
+    // Nothing reaches the file before the first keyframe has completed the
+    // header with the codec and size; a recording that never gets one is
+    // closed with this generic VP8 header
+    std::memcpy(file_header_.data(), "DKIF", 4);
+    PutLe16(&file_header_[6], kFileHeaderSize);
+    std::memcpy(&file_header_[8], "VP80", 4);
+    PutLe32(&file_header_[16], 1000);
+    PutLe32(&file_header_[20], 1);
+    file_header_written_ = false;
+    
+    writer_ = std::thread(&IvfRecorder::WriterLoop, this);
+    return true;
+}
+
+void IvfRecorder::Close() {
+    if (!file_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    
+    if (!file_header_written_) {
+        StageFileHeader();
+        Flush();
+    }
+    
+    // Frame count in the file header
+    uint8_t count[4];
+    PutLe32(count, static_cast<uint32_t>(frames_written_));
+    std::fseek(file_, 24, SEEK_SET);
+    std::fwrite(count, 1, sizeof(count), file_);
+    std::fclose(file_);
+    file_ = nullptr;
+    
+    LogRecord(LogLevel::kInfo, "recording-closed").Kv("path", path_).Kv("frames", frames_written_.load())
+        .Kv("mb", bytes_written_ / (1024 * 1024)).Kv("dropped", frames_dropped_.load());
+}
+
+size_t IvfRecorder::buffered_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ ? queued_bytes_ + kWriteChunkSize + kIvfFrameHeaderSize : 0;
+}
+
+void IvfRecorder::OnFrame(const webrtc::RecordableEncodedFrame& frame) {
+    if (need_keyframe_ && !frame.is_key_frame()) {
+        frames_dropped_++;
+        return;
+    }
+    
+    int64_t render_ms = frame.render_time().ms();
+    if (first_render_ms_ < 0) {
+        WriteHeader(frame);
+        first_render_ms_ = render_ms;
+    }
+    
+    auto buffer = frame.encoded_buffer();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_bytes_ + buffer->size() > max_queued_bytes_) {
+            // Disk can't keep up: drop until the next keyframe
+            frames_dropped_++;
+            need_keyframe_ = true;
+            return;
+        }
+        queued_bytes_ += buffer->size();
+        queue_.push_back({buffer, render_ms - first_render_ms_});
+    }
+    need_keyframe_ = false;
+    cv_.notify_one();
+}
+
+void IvfRecorder::WriteHeader(const webrtc::RecordableEncodedFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint8_t* header = file_header_.data();
+    std::memcpy(header, "DKIF", 4);
+    PutLe16(header + 4, 0);                   // Version
+    PutLe16(header + 6, kFileHeaderSize);
+    std::memcpy(header + 8, frame.codec() == webrtc::kVideoCodecVP9 ? "VP90" : "VP80", 4);
+    PutLe16(header + 12, static_cast<uint16_t>(frame.resolution().width));
+    PutLe16(header + 14, static_cast<uint16_t>(frame.resolution().height));
+    PutLe32(header + 16, 1000);               // Timebase: milliseconds
+    PutLe32(header + 20, 1);
+    PutLe32(header + 24, 0);                  // Frame count, filled in on close
+    PutLe32(header + 28, 0);
+}
+
+void IvfRecorder::StageFileHeader() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    staging_.insert(staging_.begin(), file_header_.begin(), file_header_.end());
+    file_header_written_ = true;
+}
+
+void IvfRecorder::WriterLoop() {
+    std::deque<QueuedFrame> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool ready = cv_.wait_for(lock, std::chrono::seconds(1),
+                                      [this] { return stopping_ || !queue_.empty(); });
+            if (!ready) {
+                // Idle: don't keep up to a chunk of data only in memory
+                lock.unlock();
+                Flush();
+                continue;
+            }
+            if (queue_.empty() && stopping_) {
+                break;
+            }
+            batch.swap(queue_);
+        }
+        
+        if (!file_header_written_ && !batch.empty()) {
+            StageFileHeader();
+        }
+        size_t batch_bytes = 0;
+        for (const QueuedFrame& frame : batch) {
+            size_t offset = staging_.size();
+            staging_.resize(offset + kIvfFrameHeaderSize + frame.buffer->size());
+            PutLe32(&staging_[offset], static_cast<uint32_t>(frame.buffer->size()));
+            PutLe64(&staging_[offset + 4], static_cast<uint64_t>(frame.pts_ms));
+            std::memcpy(&staging_[offset + kIvfFrameHeaderSize], frame.buffer->data(), frame.buffer->size());
+            batch_bytes += frame.buffer->size();
+            frames_written_++;
+            
+            if (staging_.size() >= kWriteChunkSize) {
+                Flush();
+            }
+        }
+        batch.clear();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_bytes_ -= batch_bytes;
+        }
+    }
+    Flush();
+}
+
+void IvfRecorder::Flush() {
+    if (staging_.empty()) {
+        return;
+    }
+    size_t written = std::fwrite(staging_.data(), 1, staging_.size(), file_);
+    bytes_written_ += written;
+    if (written != staging_.size()) {
+        std::cerr << "Short write to " << path_ << std::endl;
+    }
+    staging_.clear();
+}
@@ -0,0 +1,86 @@
+// ivf_recorder.h
+// Writes compressed VP8/VP9 frames to an IVF file on a background thread
+
+#ifndef IVF_RECORDER_H
+#define IVF_RECORDER_H
+
+#include <api/video/recordable_encoded_frame.h>
+#include <api/video/video_sink_interface.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Encoded frame sink that records to IVF. OnFrame only queues a reference
+// to the frame's buffer; a writer thread batches frames into large writes.
+// When the queue is over its byte budget frames are dropped (and counted)
+// instead of blocking the encoder, and recording resumes at the next
+// keyframe so the file stays decodable.
+class IvfRecorder : public rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame> {
+public:
+    explicit IvfRecorder(size_t max_queued_bytes = 64 * 1024 * 1024);
+    ~IvfRecorder() override;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    // VideoSinkInterface implementation (encoder queue)
+    void OnFrame(const webrtc::RecordableEncodedFrame& frame) override;
+
+    const std::string& path() const { return path_; }
+    uint64_t frames_written() const { return frames_written_; }
+    uint64_t frames_dropped() const { return frames_dropped_; }
+    uint64_t bytes_written() const { return bytes_written_; }
+    // Memory held: frames waiting for the writer plus its staging buffer
+    size_t buffered_bytes() const;
+
+private:
+    struct QueuedFrame {
+        rtc::scoped_refptr<const webrtc::EncodedImageBufferInterface> buffer;
+        int64_t pts_ms;
+    };
+
+    static constexpr size_t kFileHeaderSize = 32;
+
+    void WriterLoop();
+    void WriteHeader(const webrtc::RecordableEncodedFrame& frame);
+    // Puts the file header in front of the staged frames, once
+    void StageFileHeader();
+    void Flush();
+
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    size_t max_queued_bytes_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<QueuedFrame> queue_;
+    size_t queued_bytes_ = 0;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    // Encoder queue state
+    bool need_keyframe_ = true;
+    int64_t first_render_ms_ = -1;
+
+    // Filled in by the first keyframe (encoder queue) before that frame is
+    // queued; the writer copies it out under mutex_ ahead of the first frame
+    std::array<uint8_t, kFileHeaderSize> file_header_{};
+
+    // Writer thread state
+    std::vector<uint8_t> staging_;
+    bool file_header_written_ = false;
+
+    std::atomic<uint64_t> frames_written_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+};
+
+#endif // IVF_RECORDER_H
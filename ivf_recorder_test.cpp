@@ -0,0 +1,148 @@
+// ivf_recorder_test.cpp
+// Checks the files IvfRecorder writes: header fields, frame count, and that
+// frames before the first keyframe are skipped. Run through ctest; exits 1
+// if any check fails.
+
+#include "encoded_frame_tap.h"
+#include "ivf_recorder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct IvfFile {
+    bool ok = false;  // Header read completely
+    std::string signature;
+    std::string fourcc;
+    int width = 0;
+    int height = 0;
+    uint32_t frame_count = 0;
+    std::vector<uint32_t> frame_sizes;
+};
+
+uint32_t GetLe32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+IvfFile ReadIvf(const std::string& path) {
+    IvfFile ivf;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return ivf;
+    }
+    uint8_t header[32];
+    if (std::fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        ivf.ok = true;
+        ivf.signature.assign(reinterpret_cast<const char*>(header), 4);
+        ivf.fourcc.assign(reinterpret_cast<const char*>(header + 8), 4);
+        ivf.width = header[12] | header[13] << 8;
+        ivf.height = header[14] | header[15] << 8;
+        ivf.frame_count = GetLe32(header + 24);
+        uint8_t frame_header[12];
+        while (std::fread(frame_header, 1, sizeof(frame_header), file) == sizeof(frame_header)) {
+            uint32_t size = GetLe32(frame_header);
+            ivf.frame_sizes.push_back(size);
+            if (std::fseek(file, size, SEEK_CUR) != 0) break;
+        }
+    }
+    std::fclose(file);
+    return ivf;
+}
+
+void Feed(IvfRecorder* recorder, int frames, bool first_is_key, size_t frame_bytes) {
+    for (int i = 0; i < frames; i++) {
+        rtc::scoped_refptr<webrtc::EncodedImageBuffer> buffer = webrtc::EncodedImageBuffer::Create(frame_bytes);
+        std::memset(buffer->data(), i, buffer->size());
+        TappedEncodedFrame frame(buffer, webrtc::kVideoCodecVP8, first_is_key && i == 0,
+                                 webrtc::RecordableEncodedFrame::EncodedResolution{1280, 720},
+                                 webrtc::Timestamp::Millis(33 * i));
+        recorder->OnFrame(frame);
+    }
+}
+
+bool Expect(bool condition, const std::string& test, const std::string& what) {
+    if (!condition) {
+        std::cerr << test << ": " << what << std::endl;
+    }
+    return condition;
+}
+
+bool CheckHeader(const std::string& test, const IvfFile& ivf, uint32_t frames) {
+    bool ok = Expect(ivf.ok, test, "file header missing");
+    ok = Expect(ivf.signature == "DKIF", test, "signature is not DKIF") && ok;
+    ok = Expect(ivf.fourcc == "VP80", test, "fourcc is not VP80") && ok;
+    ok = Expect(ivf.width == 1280 && ivf.height == 720, test, "wrong dimensions") && ok;
+    ok = Expect(ivf.frame_count == frames, test, "header frame count " + std::to_string(ivf.frame_count) +
+                ", expected " + std::to_string(frames)) && ok;
+    ok = Expect(ivf.frame_sizes.size() == frames, test, "file holds " + std::to_string(ivf.frame_sizes.size()) +
+                " frames, expected " + std::to_string(frames)) && ok;
+    return ok;
+}
+
+// Frames recorded as they arrive
+bool TestRecordsFrames() {
+    const std::string test = "records_frames";
+    const std::string path = "ivf_recorder_test_frames.ivf";
+    IvfRecorder recorder;
+    if (!Expect(recorder.Open(path), test, "can't open " + path)) {
+        return false;
+    }
+    Feed(&recorder, 5, true, 1000);
+    recorder.Close();
+
+    IvfFile ivf = ReadIvf(path);
+    std::remove(path.c_str());
+    return CheckHeader(test, ivf, 5);
+}
+
+// The first keyframe arrives only after the writer's idle flush (1 s)
+bool TestLateKeyframe() {
+    const std::string test = "late_keyframe";
+    const std::string path = "ivf_recorder_test_late.ivf";
+    IvfRecorder recorder;
+    if (!Expect(recorder.Open(path), test, "can't open " + path)) {
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    Feed(&recorder, 3, true, 1000);
+    recorder.Close();
+
+    IvfFile ivf = ReadIvf(path);
+    std::remove(path.c_str());
+    return CheckHeader(test, ivf, 3);
+}
+
+// Delta frames ahead of the first keyframe can't be decoded and are skipped
+bool TestSkipsUntilKeyframe() {
+    const std::string test = "skips_until_keyframe";
+    const std::string path = "ivf_recorder_test_skip.ivf";
+    IvfRecorder recorder;
+    if (!Expect(recorder.Open(path), test, "can't open " + path)) {
+        return false;
+    }
+    Feed(&recorder, 4, false, 1000);
+    Feed(&recorder, 2, true, 1000);
+    recorder.Close();
+
+    IvfFile ivf = ReadIvf(path);
+    std::remove(path.c_str());
+    return CheckHeader(test, ivf, 2);
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    ok = TestRecordsFrames() && ok;
+    ok = TestLateKeyframe() && ok;
+    ok = TestSkipsUntilKeyframe() && ok;
+    std::cerr << (ok ? "ivf_recorder_test: passed" : "ivf_recorder_test: FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+// keyframe_coordinator.cpp
+// Implementation of the keyframe pacer
+
+#include "keyframe_coordinator.h"
+#include "async_logger.h"
+
+#include <api/units/time_delta.h>
+
+#include <algorithm>
+
+KeyframeCoordinator::KeyframeCoordinator(KeyframeCoordinatorConfig config)
+    : config_(config),
+      next_slot_(std::chrono::steady_clock::now()) {
+    config_.max_per_second = std::max(1, config_.max_per_second);
+    thread_ = rtc::Thread::Create();
+    thread_->SetName("KeyframePacer", nullptr);
+    thread_->Start();
+}
+
+KeyframeCoordinator::~KeyframeCoordinator() {
+    thread_->Stop();
+}
+
+void KeyframeCoordinator::Request(const std::string& session_id, std::weak_ptr<PeerConnectionHandler> handler,
+                                  const char* reason) {
+    requests_++;
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool queued = std::any_of(queue_.begin(), queue_.end(),
+                              [&](const Pending& pending) { return pending.session_id == session_id; });
+    auto last = last_issued_.find(session_id);
+    bool fresh = last != last_issued_.end() && now - last->second < std::chrono::milliseconds(config_.coalesce_ms);
+    if (queued || fresh) {
+        coalesced_++;
+        return;
+    }
+
+    LogRecord(LogLevel::kInfo, "keyframe-request").Session(session_id).Kv("reason", reason);
+    queue_.push_back({session_id, handler, now});
+    if (!drain_scheduled_) {
+        drain_scheduled_ = true;
+        thread_->PostTask([this]() { Drain(); });
+    }
+}
+
+void KeyframeCoordinator::RemoveSession(const std::string& session_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_issued_.erase(session_id);
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(),
+                                [&](const Pending& pending) { return pending.session_id == session_id; }),
+                 queue_.end());
+}
+
+size_t KeyframeCoordinator::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void KeyframeCoordinator::Drain() {
+    auto interval = std::chrono::microseconds(1000000 / config_.max_per_second);
+    while (true) {
+        Pending pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty()) {
+                drain_scheduled_ = false;
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now < next_slot_) {
+                int64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(next_slot_ - now).count();
+                thread_->PostDelayedTask([this]() { Drain(); }, webrtc::TimeDelta::Micros(wait_us));
+                return;
+            }
+            pending = std::move(queue_.front());
+            queue_.pop_front();
+            last_issued_[pending.session_id] = now;
+            next_slot_ = now + interval;
+        }
+
+        if (std::shared_ptr<PeerConnectionHandler> handler = pending.handler.lock()) {
+            handler->RequestKeyFrame();
+            issued_++;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+// keyframe_coordinator.h
+// Paces forced keyframes so many viewers asking at once don't cause a storm
+
+#ifndef KEYFRAME_COORDINATOR_H
+#define KEYFRAME_COORDINATOR_H
+
+#include "peer_connection_handler.h"
+
+#include <rtc_base/thread.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct KeyframeCoordinatorConfig {
+    // Forced keyframes issued per second, across all sessions
+    int max_per_second = 10;
+    // Requests for a session within this long of its last keyframe, or
+    // while one is still queued, are merged into that one
+    int coalesce_ms = 500;
+};
+
+// Every viewer has its own encoder, so one cached keyframe can't serve
+// several of them; a session that needs a picture now (shown again after
+// being hidden, recording started) gets a forced keyframe on its own
+// senders. Joins need none, since a new encoder starts with a keyframe.
+// Requests are merged per session and issued from a pacing thread at most
+// max_per_second, oldest first, so a burst (many tabs shown at once) costs
+// a steady trickle of keyframes instead of a spike of encoder CPU and egress.
+class KeyframeCoordinator {
+public:
+    explicit KeyframeCoordinator(KeyframeCoordinatorConfig config = KeyframeCoordinatorConfig());
+    ~KeyframeCoordinator();
+
+    // reason is for the log ("visible", "recording", ...)
+    void Request(const std::string& session_id, std::weak_ptr<PeerConnectionHandler> handler, const char* reason);
+    void RemoveSession(const std::string& session_id);
+
+    uint64_t requests() const { return requests_; }
+    uint64_t issued() const { return issued_; }
+    uint64_t coalesced() const { return coalesced_; }
+    size_t queued() const;
+
+private:
+    struct Pending {
+        std::string session_id;
+        std::weak_ptr<PeerConnectionHandler> handler;
+        std::chrono::steady_clock::time_point requested;
+    };
+
+    void Drain();
+
+    KeyframeCoordinatorConfig config_;
+    std::unique_ptr<rtc::Thread> thread_;
+
+    mutable std::mutex mutex_;
+    std::deque<Pending> queue_;
+    std::map<std::string, std::chrono::steady_clock::time_point> last_issued_;
+    bool drain_scheduled_ = false;
+    std::chrono::steady_clock::time_point next_slot_;
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> issued_{0};
+    std::atomic<uint64_t> coalesced_{0};
+};
+
+#endif // KEYFRAME_COORDINATOR_H
@@ -0,0 +1,185 @@
+// network_emulation.cpp
+// Implementation of the emulated link and the socket wrappers
+
+#include "network_emulation.h"
+
+#include <api/task_queue/pending_task_safety_flag.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/async_socket.h>
+#include <rtc_base/socket.h>
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+bool NetworkEmulationConfig::Parse(const std::string& spec, std::string* error) {
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            *error = "expected key=value, got \"" + item + "\"";
+            return false;
+        }
+        std::string key = item.substr(0, equals);
+        double value = std::atof(item.substr(equals + 1).c_str());
+        if (value < 0) {
+            *error = "negative value for " + key;
+            return false;
+        }
+        if (key == "delay") {
+            delay_ms = static_cast<int>(value);
+        } else if (key == "jitter") {
+            jitter_ms = static_cast<int>(value);
+        } else if (key == "loss") {
+            loss = std::min(value, 100.0) / 100.0;
+        } else if (key == "reorder") {
+            reorder = std::min(value, 100.0) / 100.0;
+        } else if (key == "rate") {
+            rate_kbps = static_cast<int>(value);
+        } else if (key == "queue") {
+            queue_ms = static_cast<int>(value);
+        } else if (key == "seed") {
+            seed = static_cast<uint32_t>(value);
+        } else {
+            *error = "unknown key \"" + key + "\" (expected delay, jitter, loss, reorder, rate, queue, seed)";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string NetworkEmulationConfig::ToString() const {
+    std::ostringstream out;
+    out << "delay=" << delay_ms << "ms jitter=" << jitter_ms << "ms loss=" << loss * 100
+        << "% reorder=" << reorder * 100 << "%";
+    if (rate_kbps > 0) {
+        out << " rate=" << rate_kbps << "kbps queue=" << queue_ms << "ms";
+    }
+    return out.str();
+}
+
+EmulatedLink::EmulatedLink(const NetworkEmulationConfig& config,
+                           std::shared_ptr<NetworkEmulationCounters> counters)
+    : config_(config),
+      counters_(counters),
+      random_(config.seed) {
+}
+
+int64_t EmulatedLink::Schedule(size_t bytes, int64_t now_us) {
+    counters_->packets++;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    if (config_.loss > 0 && unit(random_) < config_.loss) {
+        counters_->lost++;
+        return -1;
+    }
+
+    // Rate limit: the packet leaves once the bytes queued ahead of it and
+    // its own bytes have gone through the link
+    int64_t departure_us = now_us;
+    if (config_.rate_kbps > 0) {
+        int64_t start_us = std::max(now_us, link_free_us_);
+        if (start_us - now_us > static_cast<int64_t>(config_.queue_ms) * 1000) {
+            counters_->queue_drops++;
+            return -1;
+        }
+        link_free_us_ = start_us + static_cast<int64_t>(bytes) * 8000 / config_.rate_kbps;
+        departure_us = link_free_us_;
+    }
+
+    int64_t delay_us = departure_us - now_us + static_cast<int64_t>(config_.delay_ms) * 1000;
+    if (config_.jitter_ms > 0) {
+        std::uniform_int_distribution<int64_t> jitter(-config_.jitter_ms * 1000, config_.jitter_ms * 1000);
+        delay_us += jitter(random_);
+    }
+    if (config_.reorder > 0 && unit(random_) < config_.reorder) {
+        counters_->reordered++;
+        delay_us += NetworkEmulationConfig::kReorderHoldMs * 1000;
+    }
+    return std::max<int64_t>(delay_us, 0);
+}
+
+namespace {
+
+// A delayed datagram; its bytes count as held by the link until it is sent
+// or its task is cancelled
+class HeldPacket {
+public:
+    HeldPacket(std::shared_ptr<EmulatedLink> link, const void* data, size_t size)
+        : link_(std::move(link)),
+          data_(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size) {
+        link_->Hold(data_.size());
+    }
+    HeldPacket(HeldPacket&&) = default;  // Leaves link_ null
+    ~HeldPacket() {
+        if (link_) {
+            link_->Release(data_.size());
+        }
+    }
+
+    const uint8_t* data() const { return data_.data(); }
+    size_t size() const { return data_.size(); }
+
+private:
+    std::shared_ptr<EmulatedLink> link_;
+    std::vector<uint8_t> data_;
+};
+
+// UDP socket whose outgoing datagrams are delayed or dropped by the link.
+// Delayed datagrams are sent from tasks on the network thread; the safety
+// flag cancels them if the socket goes away first.
+class EmulatedUdpSocket : public rtc::AsyncSocketAdapter {
+public:
+    EmulatedUdpSocket(rtc::Socket* socket, std::shared_ptr<EmulatedLink> link)
+        : rtc::AsyncSocketAdapter(socket),
+          link_(link) {
+    }
+
+    int SendTo(const void* pv, size_t cb, const rtc::SocketAddress& addr) override {
+        int64_t delay_us = link_->Schedule(cb, rtc::TimeMicros());
+        if (delay_us < 0) {
+            return static_cast<int>(cb);  // Lost on the wire, not a socket error
+        }
+        if (delay_us == 0) {
+            return rtc::AsyncSocketAdapter::SendTo(pv, cb, addr);
+        }
+
+        rtc::Thread::Current()->PostDelayedHighPrecisionTask(
+            webrtc::SafeTask(safety_.flag(),
+                             [this, packet = HeldPacket(link_, pv, cb), addr]() {
+                                 rtc::AsyncSocketAdapter::SendTo(packet.data(), packet.size(), addr);
+                             }),
+            webrtc::TimeDelta::Micros(delay_us));
+        return static_cast<int>(cb);
+    }
+
+private:
+    std::shared_ptr<EmulatedLink> link_;
+    webrtc::ScopedTaskSafety safety_;
+};
+
+} // namespace
+
+EmulatedSocketFactory::EmulatedSocketFactory(rtc::SocketFactory* base, const NetworkEmulationConfig& config,
+                                             std::shared_ptr<NetworkEmulationCounters> counters)
+    : base_(base),
+      link_(std::make_shared<EmulatedLink>(config, counters)) {
+}
+
+rtc::Socket* EmulatedSocketFactory::CreateSocket(int family, int type) {
+    rtc::Socket* socket = base_->CreateSocket(family, type);
+    if (!socket || type != SOCK_DGRAM) {
+        return socket;
+    }
+    return new EmulatedUdpSocket(socket, link_);
+}
+
+EmulatedPacketSocketFactory::EmulatedPacketSocketFactory(rtc::Thread* network_thread,
+                                                         const NetworkEmulationConfig& config,
+                                                         std::shared_ptr<NetworkEmulationCounters> counters)
+    : EmulatedSocketFactory(network_thread->socketserver(), config, counters),
+      rtc::BasicPacketSocketFactory(static_cast<EmulatedSocketFactory*>(this)) {
+}
@@ -0,0 +1,94 @@
+// network_emulation.h
+// Delay, jitter, loss, reordering and rate limits on a session's sockets
+
+#ifndef NETWORK_EMULATION_H
+#define NETWORK_EMULATION_H
+
+#include <p2p/base/basic_packet_socket_factory.h>
+#include <rtc_base/socket_factory.h>
+#include <rtc_base/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+struct NetworkEmulationConfig {
+    int delay_ms = 0;        // One-way, added to every packet
+    int jitter_ms = 0;       // Uniform +/- around delay_ms
+    double loss = 0;         // Fraction of packets dropped (0.0 - 1.0)
+    double reorder = 0;      // Fraction held back kReorderHoldMs so later packets overtake them
+    int rate_kbps = 0;       // Link capacity; 0 = unlimited
+    int queue_ms = 300;      // Drop-tail once the rate-limited queue holds this much
+    uint32_t seed = 1;       // Same seed, same losses
+
+    static constexpr int kReorderHoldMs = 10;
+
+    bool enabled() const { return delay_ms > 0 || jitter_ms > 0 || loss > 0 || reorder > 0 || rate_kbps > 0; }
+
+    // "delay=50,jitter=10,loss=2,reorder=1,rate=2000,queue=300,seed=7"
+    // (loss and reorder in percent); unknown keys are an error
+    bool Parse(const std::string& spec, std::string* error);
+    std::string ToString() const;
+};
+
+// Totals over every emulated link that shares the object
+struct NetworkEmulationCounters {
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> lost{0};           // Random loss
+    std::atomic<uint64_t> queue_drops{0};    // Rate limiter queue full
+    std::atomic<uint64_t> reordered{0};
+};
+
+// State of one emulated link: every UDP socket of a session shares it, so
+// the rate limit applies to the session as a whole. Network thread only.
+class EmulatedLink {
+public:
+    EmulatedLink(const NetworkEmulationConfig& config, std::shared_ptr<NetworkEmulationCounters> counters);
+
+    // Microseconds from now until the packet should go out, or -1 to drop it
+    int64_t Schedule(size_t bytes, int64_t now_us);
+
+    // Delayed packets waiting to be sent (read from any thread)
+    void Hold(size_t bytes) { held_bytes_ += bytes; }
+    void Release(size_t bytes) { held_bytes_ -= bytes; }
+    size_t held_bytes() const { return held_bytes_; }
+
+private:
+    NetworkEmulationConfig config_;
+    std::shared_ptr<NetworkEmulationCounters> counters_;
+    std::mt19937 random_;
+    int64_t link_free_us_ = 0;  // When the rate limiter finishes the queued bytes
+    std::atomic<size_t> held_bytes_{0};
+};
+
+// rtc::SocketFactory that wraps the network thread's UDP sockets so that
+// what they send passes through an EmulatedLink. TCP sockets are untouched.
+class EmulatedSocketFactory : public rtc::SocketFactory {
+public:
+    EmulatedSocketFactory(rtc::SocketFactory* base, const NetworkEmulationConfig& config,
+                          std::shared_ptr<NetworkEmulationCounters> counters);
+
+    rtc::Socket* CreateSocket(int family, int type) override;
+
+    std::shared_ptr<const EmulatedLink> link() const { return link_; }
+
+private:
+    rtc::SocketFactory* base_;
+    std::shared_ptr<EmulatedLink> link_;
+};
+
+// Packet socket factory for PeerConnectionDependencies: the regular
+// BasicPacketSocketFactory on top of an EmulatedSocketFactory. Only the
+// server's egress is impaired; RTCP and feedback from the viewer arrive
+// unchanged, which is enough to drive congestion control, NACK/RTX and FEC.
+class EmulatedPacketSocketFactory : private EmulatedSocketFactory, public rtc::BasicPacketSocketFactory {
+public:
+    EmulatedPacketSocketFactory(rtc::Thread* network_thread, const NetworkEmulationConfig& config,
+                                std::shared_ptr<NetworkEmulationCounters> counters);
+
+    using EmulatedSocketFactory::link;
+};
+
+#endif // NETWORK_EMULATION_H
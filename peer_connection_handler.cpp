@@ -2,7 +2,9 @@
 // Implementation of WebRTC peer connection handler
 
 #include "peer_connection_handler.h"
+#include "async_logger.h"
 #include "encoded_video_source.h"
+#include "network_emulation.h"
 #include <rtc_base/logging.h>
 #include <thread>
 #include <chrono>
@@ -10,8 +12,12 @@
 #include <api/video_codecs/builtin_video_decoder_factory.h>
 #include <api/audio_codecs/builtin_audio_encoder_factory.h>
 #include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <api/rtc_event_log/rtc_event_log.h>
+#include <api/rtc_event_log_output_file.h>
+#include <api/stats/rtcstats_objects.h>
+#include <api/transport/bitrate_settings.h>
 
-#include <iostream>
+#include <algorithm>
 
 // PeerObserver implementation
 PeerObserver::PeerObserver(SignalingCallback callback)
@@ -25,6 +31,10 @@ void PeerObserver::SetPeerConnectionHandler(PeerConnectionHandler* handler) {
     handler_ = handler;
 }
 
+void PeerObserver::SetSessionId(const std::string& session_id) {
+    session_id_ = session_id;
+}
+
 void PeerObserver::SetThroughputReceiver(std::shared_ptr<ThroughputReceiver> receiver) {
     receiver_ = receiver;
 }
@@ -42,53 +52,53 @@ void PeerObserver::OnRenegotiationNeeded() {
 }
 
 void PeerObserver::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) {
-    const char* state_names[] = {"NEW", "CHECKING", "CONNECTED", "COMPLETED", "FAILED", "DISCONNECTED", "CLOSED"};
-    std::cout << "🧊 ICE connection state: " << new_state;
-    if (new_state <= 6) {
-        std::cout << " (" << state_names[new_state] << ")";
-    }
-    std::cout << std::endl;
-    
+    const char* state_names[] = {"new", "checking", "connected", "completed", "failed", "disconnected", "closed"};
+    const char* name = new_state <= 6 ? state_names[new_state] : "unknown";
     if (new_state == webrtc::PeerConnectionInterface::IceConnectionState::kIceConnectionFailed) {
-        std::cout << "❌ ICE CONNECTION FAILED" << std::endl;
-        std::cout << "   Possible causes:" << std::endl;
-        std::cout << "   - Firewall blocking UDP ports" << std::endl;
-        std::cout << "   - No matching candidate pairs" << std::endl;
-        std::cout << "   - Client and server can't reach each other" << std::endl;
-    } else if (new_state == webrtc::PeerConnectionInterface::IceConnectionState::kIceConnectionConnected) {
-        std::cout << "✅ ICE CONNECTED - Video should be flowing now!" << std::endl;
-    } else if (new_state == webrtc::PeerConnectionInterface::IceConnectionState::kIceConnectionChecking) {
-        std::cout << "⏳ ICE CHECKING - Testing candidate pairs..." << std::endl;
+        LogRecord(LogLevel::kWarning, "ice-state").Session(session_id_).Kv("state", name)
+            .Kv("hint", "firewall blocking UDP, no matching candidate pairs, or peers can't reach each other");
+    } else {
+        LogRecord(LogLevel::kInfo, "ice-state").Session(session_id_).Kv("state", name);
     }
 }
 
-void PeerObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) {
-    const char* state_names[] = {"NEW", "GATHERING", "COMPLETE"};
-    std::cout << "🧊 ICE gathering state: " << new_state;
-    if (new_state <= 2) {
-        std::cout << " (" << state_names[new_state] << ")";
-    }
-    std::cout << std::endl;
-    
-    if (new_state == webrtc::PeerConnectionInterface::IceGatheringState::kIceGatheringComplete) {
-        std::cout << "✅ ICE gathering complete - all candidates sent" << std::endl;
+void PeerObserver::OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) {
+    if (handler_) {
+        handler_->OnConnectionStateChange(new_state);
     }
 }
 
+void PeerObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) {
+    const char* state_names[] = {"new", "gathering", "complete"};
+    LogRecord(LogLevel::kInfo, "ice-gathering").Session(session_id_)
+        .Kv("state", new_state <= 2 ? state_names[new_state] : "unknown");
+}
+
 void PeerObserver::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
     std::string sdp;
     if (candidate->ToString(&sdp)) {
-        // Log the full candidate for debugging
-        std::cout << "🧊 ICE Candidate: " << sdp << std::endl;
+        LogRecord(LogLevel::kDebug, "ice-candidate").Session(session_id_).Kv("candidate", sdp);
         
-        // Send ICE candidate to client
-        signaling_callback_("ice-candidate", sdp);
+        // Send ICE candidate to client as a ready-to-send signaling message.
+        // Candidate lines never contain quotes or backslashes, so no escaping is needed.
+        std::string message = "{\"type\":\"ice-candidate\",\"candidate\":\"" + sdp +
+                              "\",\"sdpMid\":\"" + candidate->sdp_mid() +
+                              "\",\"sdpMLineIndex\":" + std::to_string(candidate->sdp_mline_index()) + "}";
+        signaling_callback_("ice-candidate", message);
         RTC_LOG(LS_INFO) << "ICE candidate: " << candidate->sdp_mid();
     }
 }
 
 void PeerObserver::OnTrack(rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) {
     RTC_LOG(LS_INFO) << "Track received";
+    
+    // Ingest: decoded frames from the peer go to the throughput receiver
+    // (with the null decoder factory no frames come out, only RTP stats)
+    auto track = transceiver->receiver()->track();
+    if (receiver_ && track && track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind) {
+        static_cast<webrtc::VideoTrackInterface*>(track.get())->AddOrUpdateSink(receiver_.get(), rtc::VideoSinkWants());
+        LogRecord(LogLevel::kInfo, "ingest-track").Session(session_id_);
+    }
 }
 
 // CreateSDPObserver implementation
@@ -114,19 +124,62 @@ void SetSDPObserver::OnSuccess() {
 }
 
 void SetSDPObserver::OnFailure(webrtc::RTCError error) {
-    std::cout << "❌ SetRemoteDescription FAILED: " << error.message() << std::endl;
+    LogRecord(LogLevel::kError, "set-description-failed").Kv("error", error.message());
     RTC_LOG(LS_ERROR) << "Set SDP failed: " << error.message();
 }
 
+// StatsObserver implementation
+StatsObserver::StatsObserver(std::function<void(const rtc::scoped_refptr<const webrtc::RTCStatsReport>&)> callback)
+    : callback_(callback) {
+}
+
+void StatsObserver::OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+    callback_(report);
+}
+
 // PeerConnectionHandler implementation
+namespace {
+
+int64_t SteadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Memory estimate: input frame plus reference frames per encoder (I420),
+// and libwebrtc's minimum RTP packet history per stream
+constexpr size_t kEncoderFrameBuffers = 4;
+constexpr size_t kPacketHistoryBytes = 600 * 1200;
+
+// Layer kept for hidden viewers in HiddenMode::kThumbnail
+constexpr double kThumbnailScaleDown = 8.0;
+constexpr double kThumbnailFps = 5;
+constexpr int kThumbnailBitrateBps = 150000;
+
+} // namespace
+
+const char* SessionStateName(SessionState state) {
+    switch (state) {
+        case SessionState::kNew: return "new";
+        case SessionState::kConnecting: return "connecting";
+        case SessionState::kConnected: return "connected";
+        case SessionState::kDisconnected: return "disconnected";
+        case SessionState::kFailed: return "failed";
+        case SessionState::kClosed: return "closed";
+    }
+    return "unknown";
+}
+
 PeerConnectionHandler::PeerConnectionHandler(
     rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory,
     std::shared_ptr<EncodedVideoSource> video_source,
-    SignalingCallback signaling_callback)
+    SignalingCallback signaling_callback,
+    std::unique_ptr<rtc::PacketSocketFactory> packet_socket_factory)
     : factory_(factory),
       video_source_(video_source),
       signaling_callback_(signaling_callback) {
     
+    state_since_ms_ = SteadyNowMs();
+    last_activity_ms_ = state_since_ms_.load();
     receiver_ = std::make_shared<ThroughputReceiver>();
     observer_ = std::make_unique<PeerObserver>(signaling_callback);
     observer_->SetThroughputReceiver(receiver_);
@@ -155,72 +208,104 @@ PeerConnectionHandler::PeerConnectionHandler(
     config.servers.push_back(stun_server);
     */
     
-    peer_connection_ = factory_->CreatePeerConnection(
-        config,
-        nullptr,
-        nullptr,
-        observer_.get()
-    );
+    webrtc::PeerConnectionDependencies dependencies(observer_.get());
+    dependencies.packet_socket_factory = std::move(packet_socket_factory);
+    auto result = factory_->CreatePeerConnectionOrError(config, std::move(dependencies));
     
-    if (!peer_connection_) {
-        RTC_LOG(LS_ERROR) << "Failed to create peer connection";
+    if (!result.ok()) {
+        RTC_LOG(LS_ERROR) << "Failed to create peer connection: " << result.error().message();
         return;
     }
+    peer_connection_ = result.MoveValue();
     
     // Add video track - pass video source directly as it now implements VideoTrackSourceInterface
-    rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track = 
-        factory_->CreateVideoTrack("video", video_source.get());
-    
-    auto result = peer_connection_->AddTrack(video_track, {"stream"});
-    
-    if (!result.ok()) {
-        RTC_LOG(LS_ERROR) << "Failed to add track: " << result.error().message();
+    // (no source: data channel only session)
+    if (video_source) {
+        video_sender_ = AddTrackForSource(video_source.get(), "video");
     }
     
     RTC_LOG(LS_INFO) << "Peer connection created with STUN support";
 }
 
 PeerConnectionHandler::~PeerConnectionHandler() {
+    StopRecording();
     if (peer_connection_) {
         peer_connection_->Close();
     }
 }
 
+rtc::scoped_refptr<webrtc::RtpSenderInterface> PeerConnectionHandler::AddTrackForSource(
+    EncodedVideoSource* source, const std::string& track_id) {
+    rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track = 
+        factory_->CreateVideoTrack(track_id, source);
+    if (source->is_screencast()) {
+        // Sharp, mostly static content: keep resolution, let frame rate drop
+        video_track->set_content_hint(webrtc::VideoTrackInterface::ContentHint::kText);
+    }
+    
+    // All tracks share one stream, so they also share one transport (bundle)
+    auto result = peer_connection_->AddTrack(video_track, {"stream"});
+    if (!result.ok()) {
+        RTC_LOG(LS_ERROR) << "Failed to add track: " << result.error().message();
+        return nullptr;
+    }
+    return result.value();
+}
+
+bool PeerConnectionHandler::AddVideoTrack(std::shared_ptr<EncodedVideoSource> source) {
+    if (!peer_connection_ || !source) {
+        return false;
+    }
+    
+    std::string track_id = "video" + std::to_string(extra_tracks_.size() + 1);
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> sender = AddTrackForSource(source.get(), track_id);
+    if (!sender) {
+        return false;
+    }
+    
+    BitrateProfile profile = SelectBitrateProfile(source->GetWidth(), source->GetHeight(), source->GetFps());
+    webrtc::RtpParameters parameters = sender->GetParameters();
+    for (auto& encoding : parameters.encodings) {
+        encoding.min_bitrate_bps = profile.min_bitrate_bps;
+        encoding.max_bitrate_bps = profile.max_bitrate_bps;
+    }
+    webrtc::RTCError error = sender->SetParameters(parameters);
+    if (!error.ok()) {
+        RTC_LOG(LS_ERROR) << "SetParameters failed: " << error.message();
+    }
+    
+    extra_tracks_.push_back({source, sender, profile});
+    return true;
+}
+
 void PeerConnectionHandler::HandleOffer(const std::string& sdp) {
-    std::cout << "📥 HandleOffer called with SDP length: " << sdp.length() << std::endl;
+    if (offer_received_ms_ == 0) {
+        offer_received_ms_ = SteadyNowMs();
+    }
+    LogRecord(LogLevel::kInfo, "offer").Session(session_id_).Kv("sdp_bytes", sdp.length());
     RTC_LOG(LS_INFO) << "Received offer";
     
-    // Create session description from SDP
-    std::cout << "1️⃣ Creating session description..." << std::endl;
     webrtc::SdpParseError error;
     std::unique_ptr<webrtc::SessionDescriptionInterface> session_description_ptr =
         webrtc::CreateSessionDescription(webrtc::SdpType::kOffer, sdp, &error);
     
     if (!session_description_ptr) {
-        std::cout << "❌ Failed to parse offer SDP!" << std::endl;
+        LogRecord(LogLevel::kError, "offer-parse-failed").Session(session_id_).Kv("error", error.description);
         RTC_LOG(LS_ERROR) << "Failed to parse offer: " << error.description;
         return;
     }
-    std::cout << "✅ Session description created" << std::endl;
     
     // Get raw pointer and release ownership - SetRemoteDescription takes ownership
-    std::cout << "2️⃣ Getting raw pointer..." << std::endl;
     webrtc::SessionDescriptionInterface* session_description = session_description_ptr.release();
-    std::cout << "✅ Raw pointer obtained" << std::endl;
     
     // Set remote description - older API takes raw pointer and observer
-    std::cout << "3️⃣ Creating SetSDP observer..." << std::endl;
     auto set_observer = new rtc::RefCountedObject<SetSDPObserver>([this]() {
         RTC_LOG(LS_INFO) << "✅ Remote description set successfully!";
-        std::cout << "✅ Remote description set, creating answer to trigger ICE gathering..." << std::endl;
+        LogRecord(LogLevel::kDebug, "remote-description-set").Session(session_id_);
         // Create answer immediately - this triggers ICE gathering
         CreateAnswer();
     });
-    std::cout << "✅ Observer created" << std::endl;
-    
-    std::cout << "4️⃣ Calling SetRemoteDescription..." << std::endl;
     peer_connection_->SetRemoteDescription(set_observer, session_description);
-    std::cout << "📤 SetRemoteDescription called, waiting for callback..." << std::endl;
 }
 
 void PeerConnectionHandler::CreateAnswer() {
@@ -265,3 +350,539 @@ void PeerConnectionHandler::HandleIceCandidate(
         RTC_LOG(LS_ERROR) << "Failed to add ICE candidate";
     }
 }
+
+void PeerConnectionHandler::ApplyBitrateProfile(const BitrateProfile& profile) {
+    if (!peer_connection_) {
+        return;
+    }
+    
+    profile_ = profile;
+    has_profile_ = true;
+    
+    // Congestion controller: begin at the profile's start rate instead of the
+    // libwebrtc default (~300 kbps) so 4K viewers skip the slow ramp
+    webrtc::BitrateSettings settings;
+    settings.min_bitrate_bps = profile.min_bitrate_bps;
+    settings.start_bitrate_bps = profile.start_bitrate_bps;
+    settings.max_bitrate_bps = profile.max_bitrate_bps;
+    for (const ExtraTrack& track : extra_tracks_) {
+        // One congestion controller carries every track
+        *settings.start_bitrate_bps += track.profile.start_bitrate_bps;
+        *settings.max_bitrate_bps += track.profile.max_bitrate_bps;
+    }
+    webrtc::RTCError error = peer_connection_->SetBitrate(settings);
+    if (!error.ok()) {
+        RTC_LOG(LS_ERROR) << "SetBitrate failed: " << error.message();
+    }
+    
+    // Encoder: without an explicit max, libwebrtc caps large resolutions at a
+    // few Mbps regardless of the available bandwidth
+    if (video_sender_) {
+        webrtc::RtpParameters parameters = video_sender_->GetParameters();
+        for (auto& encoding : parameters.encodings) {
+            encoding.min_bitrate_bps = profile.min_bitrate_bps;
+            encoding.max_bitrate_bps = profile.max_bitrate_bps;
+        }
+        error = video_sender_->SetParameters(parameters);
+        if (!error.ok()) {
+            RTC_LOG(LS_ERROR) << "SetParameters failed: " << error.message();
+        }
+    }
+    
+    LogRecord(LogLevel::kInfo, "bitrate-profile").Session(session_id_).Kv("profile", profile.name)
+        .Kv("start_mbps", profile.start_bitrate_bps / 1000000.0)
+        .Kv("min_mbps", profile.min_bitrate_bps / 1000000.0)
+        .Kv("max_mbps", profile.max_bitrate_bps / 1000000.0);
+}
+
+void PeerConnectionHandler::ApplyQuality(const QualitySettings& quality) {
+    if (!video_sender_) {
+        return;
+    }
+    if (hidden_) {
+        // Applied on top of the restored encodings when shown again
+        pending_quality_ = quality;
+        has_pending_quality_ = true;
+        return;
+    }
+    
+    // Extra tracks step down with the first one; their bitrate caps scale
+    // by the same fraction of their own profile
+    double bitrate_fraction = quality.max_bitrate_bps > 0 && has_profile_ && profile_.max_bitrate_bps > 0
+        ? static_cast<double>(quality.max_bitrate_bps) / profile_.max_bitrate_bps
+        : 1.0;
+    std::vector<std::pair<webrtc::RtpSenderInterface*, int>> senders = {
+        {video_sender_.get(), quality.max_bitrate_bps}};
+    for (const ExtraTrack& track : extra_tracks_) {
+        int max_bitrate_bps = quality.max_bitrate_bps > 0
+            ? static_cast<int>(track.profile.max_bitrate_bps * bitrate_fraction)
+            : 0;
+        senders.emplace_back(track.sender.get(), max_bitrate_bps);
+    }
+    
+    for (const auto& [sender, max_bitrate_bps] : senders) {
+        webrtc::RtpParameters parameters = sender->GetParameters();
+        for (auto& encoding : parameters.encodings) {
+            encoding.scale_resolution_down_by = quality.scale_resolution_down_by;
+            if (quality.max_framerate > 0) {
+                encoding.max_framerate = quality.max_framerate;
+            }
+            if (max_bitrate_bps > 0) {
+                encoding.max_bitrate_bps = max_bitrate_bps;
+                // Keep min <= max or SetParameters rejects the change
+                if (encoding.min_bitrate_bps && *encoding.min_bitrate_bps > max_bitrate_bps) {
+                    encoding.min_bitrate_bps = max_bitrate_bps;
+                }
+            }
+        }
+        parameters.degradation_preference = quality.degradation_preference;
+        
+        webrtc::RTCError error = sender->SetParameters(parameters);
+        if (!error.ok()) {
+            RTC_LOG(LS_ERROR) << "SetParameters failed: " << error.message();
+        }
+    }
+}
+
+std::vector<webrtc::RtpSenderInterface*> PeerConnectionHandler::GetVideoSenders() const {
+    std::vector<webrtc::RtpSenderInterface*> senders;
+    if (video_sender_) {
+        senders.push_back(video_sender_.get());
+    }
+    for (const ExtraTrack& track : extra_tracks_) {
+        senders.push_back(track.sender.get());
+    }
+    return senders;
+}
+
+void PeerConnectionHandler::SetVisible(bool visible, HiddenMode mode) {
+    if (hidden_ == !visible) {
+        return;
+    }
+    std::vector<webrtc::RtpSenderInterface*> senders = GetVideoSenders();
+    
+    if (!visible) {
+        saved_encodings_.clear();
+        for (webrtc::RtpSenderInterface* sender : senders) {
+            webrtc::RtpParameters parameters = sender->GetParameters();
+            saved_encodings_.push_back(parameters.encodings);
+            for (auto& encoding : parameters.encodings) {
+                if (mode == HiddenMode::kSuspend) {
+                    encoding.active = false;
+                } else {
+                    encoding.scale_resolution_down_by = kThumbnailScaleDown;
+                    encoding.max_framerate = kThumbnailFps;
+                    encoding.max_bitrate_bps = kThumbnailBitrateBps;
+                    encoding.min_bitrate_bps = absl::nullopt;
+                }
+            }
+            webrtc::RTCError error = sender->SetParameters(parameters);
+            if (!error.ok()) {
+                RTC_LOG(LS_ERROR) << "SetParameters (hide) failed: " << error.message();
+            }
+        }
+        hidden_ = true;
+        return;
+    }
+    
+    hidden_ = false;
+    for (size_t i = 0; i < senders.size() && i < saved_encodings_.size(); i++) {
+        webrtc::RtpParameters parameters = senders[i]->GetParameters();
+        if (parameters.encodings.size() == saved_encodings_[i].size()) {
+            parameters.encodings = saved_encodings_[i];
+        }
+        webrtc::RTCError error = senders[i]->SetParameters(parameters);
+        if (!error.ok()) {
+            RTC_LOG(LS_ERROR) << "SetParameters (show) failed: " << error.message();
+        }
+    }
+    saved_encodings_.clear();
+    if (has_pending_quality_) {
+        has_pending_quality_ = false;
+        ApplyQuality(pending_quality_);
+    }
+}
+
+int PeerConnectionHandler::GetSourceFps() const {
+    return video_source_ ? video_source_->GetFps() : 0;
+}
+
+void PeerConnectionHandler::PollStats() {
+    if (!peer_connection_) {
+        return;
+    }
+    
+    auto stats_observer = new rtc::RefCountedObject<StatsObserver>(
+        [this](const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+            OnStats(report);
+        });
+    peer_connection_->GetStats(stats_observer);
+}
+
+void PeerConnectionHandler::OnConnectionStateChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) {
+    using PeerConnectionState = webrtc::PeerConnectionInterface::PeerConnectionState;
+    SessionState state = SessionState::kNew;
+    switch (new_state) {
+        case PeerConnectionState::kNew: state = SessionState::kNew; break;
+        case PeerConnectionState::kConnecting: state = SessionState::kConnecting; break;
+        case PeerConnectionState::kConnected: state = SessionState::kConnected; break;
+        case PeerConnectionState::kDisconnected: state = SessionState::kDisconnected; break;
+        case PeerConnectionState::kFailed: state = SessionState::kFailed; break;
+        case PeerConnectionState::kClosed: state = SessionState::kClosed; break;
+    }
+    if (static_cast<SessionState>(state_.exchange(static_cast<int>(state))) != state) {
+        state_since_ms_ = SteadyNowMs();
+        if (state == SessionState::kConnected) {
+            last_activity_ms_ = state_since_ms_.load();
+        }
+    }
+    if (state == SessionState::kConnected && connect_ms_ < 0 && offer_received_ms_ > 0) {
+        connect_ms_ = SteadyNowMs() - offer_received_ms_;
+    }
+}
+
+void PeerConnectionHandler::SetSessionId(const std::string& session_id) {
+    session_id_ = session_id;
+    observer_->SetSessionId(session_id);
+    receiver_->SetSessionId(session_id);
+}
+
+void PeerConnectionHandler::RequestKeyFrame() {
+    for (webrtc::RtpSenderInterface* sender : GetVideoSenders()) {
+        webrtc::RTCError error = sender->GenerateKeyFrame({});
+        if (!error.ok()) {
+            RTC_LOG(LS_WARNING) << "GenerateKeyFrame failed: " << error.message();
+        }
+    }
+}
+
+int64_t PeerConnectionHandler::GetStateAgeMs() const {
+    return SteadyNowMs() - state_since_ms_;
+}
+
+int64_t PeerConnectionHandler::GetIdleMs() const {
+    return SteadyNowMs() - last_activity_ms_;
+}
+
+size_t PeerConnectionHandler::EstimateMemoryBytes() const {
+    std::vector<std::pair<std::string, EncodedVideoSource*>> tracks;
+    if (video_sender_) {
+        tracks.emplace_back("video", video_source_.get());
+    }
+    for (size_t i = 0; i < extra_tracks_.size(); i++) {
+        tracks.emplace_back("video" + std::to_string(i + 1), extra_tracks_[i].source.get());
+    }
+    
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (const auto& [track_id, source] : tracks) {
+            // Suspended tracks report no frame size but keep their encoder
+            size_t width = source->GetWidth();
+            size_t height = source->GetHeight();
+            for (const TrackStats& track : latest_stats_.tracks) {
+                if (track.track_id == track_id && track.frame_width > 0) {
+                    width = track.frame_width;
+                    height = track.frame_height;
+                }
+            }
+            bytes += width * height * 3 / 2 * kEncoderFrameBuffers + kPacketHistoryBytes;
+        }
+    }
+    
+    for (const TrackRecording& recording : recordings_) {
+        bytes += recording.recorder->buffered_bytes();
+    }
+    if (data_streamer_) {
+        bytes += data_streamer_->buffered_amount();
+    }
+    if (emulated_link_) {
+        bytes += emulated_link_->held_bytes();
+    }
+    return bytes;
+}
+
+bool PeerConnectionHandler::StartDataChannelBench(const DataChannelBenchConfig& config) {
+    if (!peer_connection_) {
+        return false;
+    }
+    
+    webrtc::DataChannelInit init;
+    init.negotiated = true;
+    init.id = DataChannelBenchConfig::kChannelId;
+    init.ordered = config.ordered;
+    if (config.max_retransmits >= 0) {
+        init.maxRetransmits = config.max_retransmits;
+    }
+    
+    auto result = peer_connection_->CreateDataChannelOrError("bench", &init);
+    if (!result.ok()) {
+        RTC_LOG(LS_ERROR) << "Failed to create data channel: " << result.error().message();
+        return false;
+    }
+    data_streamer_ = std::make_unique<DataChannelStreamer>(result.MoveValue(), config);
+    return true;
+}
+
+DataChannelBenchStats PeerConnectionHandler::SampleDataChannelBench() {
+    return data_streamer_ ? data_streamer_->Sample() : DataChannelBenchStats();
+}
+
+bool PeerConnectionHandler::StartRecording(const std::string& path) {
+    std::vector<webrtc::RtpSenderInterface*> senders = GetVideoSenders();
+    if (senders.empty() || !recordings_.empty()) {
+        return false;
+    }
+    
+    // Open every file before touching a sender, so a failure leaves none tapped
+    std::vector<TrackRecording> recordings;
+    for (size_t i = 0; i < senders.size(); i++) {
+        std::string track_path = path;
+        if (i > 0) {
+            size_t dot = path.rfind('.');
+            size_t insert_at = dot != std::string::npos && path.find('/', dot) == std::string::npos ? dot : path.size();
+            track_path.insert(insert_at, "_track" + std::to_string(i));
+        }
+        TrackRecording recording;
+        recording.sender = rtc::scoped_refptr<webrtc::RtpSenderInterface>(senders[i]);
+        recording.recorder = std::make_unique<IvfRecorder>();
+        if (!recording.recorder->Open(track_path)) {
+            for (TrackRecording& opened : recordings) {
+                opened.recorder->Close();
+            }
+            return false;
+        }
+        recordings.push_back(std::move(recording));
+        LogRecord(LogLevel::kInfo, "recording").Session(session_id_).Kv("track", i).Kv("path", track_path);
+    }
+    
+    // Each tap reconfigures its send stream; it stays until StopRecording
+    for (TrackRecording& recording : recordings) {
+        recording.tap = rtc::make_ref_counted<EncodedFrameTap>();
+        recording.tap->sinks().Add(recording.recorder.get());
+        recording.sender->SetEncoderToPacketizerFrameTransformer(recording.tap);
+    }
+    recordings_ = std::move(recordings);
+    return true;
+}
+
+void PeerConnectionHandler::StopRecording() {
+    for (TrackRecording& recording : recordings_) {
+        // No frame reaches the recorder once it is out of the tap's sinks
+        recording.tap->sinks().Remove(recording.recorder.get());
+        recording.sender->SetEncoderToPacketizerFrameTransformer(nullptr);
+        recording.recorder->Close();
+    }
+    recordings_.clear();
+}
+
+uint64_t PeerConnectionHandler::GetRecordedFrames() const {
+    uint64_t frames = 0;
+    for (const TrackRecording& recording : recordings_) {
+        frames += recording.recorder->frames_written();
+    }
+    return frames;
+}
+
+uint64_t PeerConnectionHandler::GetRecordingDrops() const {
+    uint64_t drops = 0;
+    for (const TrackRecording& recording : recordings_) {
+        drops += recording.recorder->frames_dropped();
+    }
+    return drops;
+}
+
+bool PeerConnectionHandler::StartEventLog(const std::string& path) {
+    if (!peer_connection_) {
+        return false;
+    }
+    
+    auto output = std::make_unique<webrtc::RtcEventLogOutputFile>(path, webrtc::RtcEventLog::kUnlimitedOutput);
+    if (!output->IsActive()) {
+        LogRecord(LogLevel::kError, "event-log-failed").Session(session_id_).Kv("path", path);
+        return false;
+    }
+    
+    // Batch writes every 5 seconds instead of one write per event
+    bool started = peer_connection_->StartRtcEventLog(std::move(output), 5000);
+    if (started) {
+        LogRecord(LogLevel::kInfo, "event-log").Session(session_id_).Kv("path", path);
+    }
+    return started;
+}
+
+void PeerConnectionHandler::StopEventLog() {
+    if (peer_connection_) {
+        peer_connection_->StopRtcEventLog();
+    }
+}
+
+SessionStats PeerConnectionHandler::GetLatestStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return latest_stats_;
+}
+
+void PeerConnectionHandler::OnStats(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+    SessionStats stats;
+    stats.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    
+    for (const auto* pair : report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+        if (!pair->nominated.is_defined() || !*pair->nominated) {
+            continue;
+        }
+        if (pair->available_outgoing_bitrate.is_defined()) {
+            stats.available_outgoing_bitrate_bps = *pair->available_outgoing_bitrate;
+        }
+        if (pair->current_round_trip_time.is_defined()) {
+            stats.round_trip_time_s = *pair->current_round_trip_time;
+        }
+        if (pair->bytes_received.is_defined()) {
+            stats.transport_bytes_received = *pair->bytes_received;
+        }
+    }
+    
+    for (const auto* remote : report->GetStatsOfType<webrtc::RTCRemoteInboundRtpStreamStats>()) {
+        if (!remote->kind.is_defined() || *remote->kind != "video") {
+            continue;
+        }
+        if (remote->fraction_lost.is_defined()) {
+            stats.fraction_lost = std::max(stats.fraction_lost, *remote->fraction_lost);
+        }
+        if (remote->round_trip_time.is_defined()) {
+            stats.round_trip_time_s = *remote->round_trip_time;
+        }
+    }
+    
+    for (const auto* outbound : report->GetStatsOfType<webrtc::RTCOutboundRtpStreamStats>()) {
+        if (!outbound->kind.is_defined() || *outbound->kind != "video") {
+            continue;
+        }
+        
+        // The media source names the track this stream sends
+        TrackStats track;
+        if (outbound->media_source_id.is_defined()) {
+            const webrtc::RTCStats* source = report->Get(*outbound->media_source_id);
+            if (source && source->type() == webrtc::RTCVideoSourceStats::kType) {
+                const auto& video_source = source->cast_to<webrtc::RTCVideoSourceStats>();
+                if (video_source.track_identifier.is_defined()) {
+                    track.track_id = *video_source.track_identifier;
+                }
+            }
+        }
+        if (outbound->frame_width.is_defined()) track.frame_width = *outbound->frame_width;
+        if (outbound->frame_height.is_defined()) track.frame_height = *outbound->frame_height;
+        if (outbound->frames_per_second.is_defined()) track.frames_per_second = *outbound->frames_per_second;
+        if (outbound->bytes_sent.is_defined()) track.bytes_sent = *outbound->bytes_sent;
+        if (outbound->frames_encoded.is_defined()) track.frames_encoded = *outbound->frames_encoded;
+        if (outbound->total_encode_time.is_defined()) track.total_encode_time_s = *outbound->total_encode_time;
+        stats.tracks.push_back(track);
+        
+        if (outbound->bytes_sent.is_defined()) {
+            stats.bytes_sent += *outbound->bytes_sent;
+        }
+        if (outbound->target_bitrate.is_defined()) {
+            stats.target_bitrate_bps += *outbound->target_bitrate;
+        }
+        if (outbound->frames_encoded.is_defined()) {
+            stats.frames_encoded += *outbound->frames_encoded;
+        }
+        if (outbound->total_encode_time.is_defined()) {
+            stats.total_encode_time_s += *outbound->total_encode_time;
+        }
+        if (outbound->frames_per_second.is_defined()) {
+            stats.frames_per_second = std::max(stats.frames_per_second, *outbound->frames_per_second);
+        }
+        if (outbound->quality_limitation_reason.is_defined()) {
+            stats.quality_limitation_reason = *outbound->quality_limitation_reason;
+        }
+    }
+    
+    for (const auto* inbound : report->GetStatsOfType<webrtc::RTCInboundRtpStreamStats>()) {
+        if (!inbound->kind.is_defined() || *inbound->kind != "video") {
+            continue;
+        }
+        if (inbound->bytes_received.is_defined()) {
+            stats.bytes_received += *inbound->bytes_received;
+        }
+        if (inbound->frames_received.is_defined()) {
+            stats.frames_received += *inbound->frames_received;
+        }
+        if (inbound->frames_decoded.is_defined()) {
+            stats.frames_decoded += *inbound->frames_decoded;
+        }
+        if (inbound->total_decode_time.is_defined()) {
+            stats.total_decode_time_s += *inbound->total_decode_time;
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        if (latest_stats_.timestamp_us > 0 && stats.timestamp_us > latest_stats_.timestamp_us) {
+            double elapsed_s = (stats.timestamp_us - latest_stats_.timestamp_us) / 1000000.0;
+            if (stats.bytes_received >= latest_stats_.bytes_received) {
+                stats.receive_bitrate_bps = (stats.bytes_received - latest_stats_.bytes_received) * 8.0 / elapsed_s;
+            }
+            if (stats.frames_received >= latest_stats_.frames_received) {
+                stats.receive_fps = (stats.frames_received - latest_stats_.frames_received) / elapsed_s;
+            }
+        }
+        if (stats.frames_decoded > latest_stats_.frames_decoded) {
+            stats.decode_ms_per_frame = (stats.total_decode_time_s - latest_stats_.total_decode_time_s) * 1000.0 /
+                                        (stats.frames_decoded - latest_stats_.frames_decoded);
+        }
+        if (latest_stats_.timestamp_us > 0 && stats.timestamp_us > latest_stats_.timestamp_us &&
+            stats.bytes_sent >= latest_stats_.bytes_sent) {
+            stats.send_bitrate_bps = (stats.bytes_sent - latest_stats_.bytes_sent) * 8.0 * 1000000.0 /
+                                     (stats.timestamp_us - latest_stats_.timestamp_us);
+        }
+        if (latest_stats_.timestamp_us > 0 && stats.timestamp_us > latest_stats_.timestamp_us &&
+            stats.total_encode_time_s >= latest_stats_.total_encode_time_s) {
+            stats.encode_cpu_cores = (stats.total_encode_time_s - latest_stats_.total_encode_time_s) * 1000000.0 /
+                                     (stats.timestamp_us - latest_stats_.timestamp_us);
+        }
+        if (stats.transport_bytes_received != latest_stats_.transport_bytes_received) {
+            last_activity_ms_ = SteadyNowMs();
+        }
+        if (stats.frames_encoded > latest_stats_.frames_encoded) {
+            stats.encode_ms_per_frame = (stats.total_encode_time_s - latest_stats_.total_encode_time_s) * 1000.0 /
+                                        (stats.frames_encoded - latest_stats_.frames_encoded);
+        }
+        
+        std::sort(stats.tracks.begin(), stats.tracks.end(),
+                  [](const TrackStats& a, const TrackStats& b) { return a.track_id < b.track_id; });
+        for (TrackStats& track : stats.tracks) {
+            auto last = std::find_if(latest_stats_.tracks.begin(), latest_stats_.tracks.end(),
+                                     [&](const TrackStats& t) { return t.track_id == track.track_id; });
+            if (last == latest_stats_.tracks.end()) {
+                continue;
+            }
+            if (stats.timestamp_us > latest_stats_.timestamp_us && track.bytes_sent >= last->bytes_sent) {
+                track.send_bitrate_bps = (track.bytes_sent - last->bytes_sent) * 8.0 * 1000000.0 /
+                                         (stats.timestamp_us - latest_stats_.timestamp_us);
+            }
+            if (track.frames_encoded > last->frames_encoded) {
+                track.encode_ms_per_frame = (track.total_encode_time_s - last->total_encode_time_s) * 1000.0 /
+                                            (track.frames_encoded - last->frames_encoded);
+            }
+        }
+        latest_stats_ = stats;
+    }
+    
+    // Time-to-target: from the first media bytes until the encoder target
+    // reaches (90% of) the profile's start bitrate
+    if (!has_profile_ || time_to_target_ms_ >= 0) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (!media_started_ && stats.bytes_sent > 0) {
+        media_started_ = true;
+        media_start_time_ = now;
+    }
+    if (media_started_ && stats.target_bitrate_bps >= 0.9 * profile_.start_bitrate_bps) {
+        time_to_target_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - media_start_time_).count();
+        LogRecord(LogLevel::kInfo, "target-bitrate-reached").Session(session_id_)
+            .Kv("mbps", stats.target_bitrate_bps / 1000000.0).Kv("ms", time_to_target_ms_.load());
+    }
+}
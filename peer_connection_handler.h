@@ -4,23 +4,101 @@
 #ifndef PEER_CONNECTION_HANDLER_H
 #define PEER_CONNECTION_HANDLER_H
 
+#include "bitrate_profile.h"
+#include "data_channel_bench.h"
+#include "encoded_frame_tap.h"
+#include "ivf_recorder.h"
 #include "throughput_receiver.h"
 
 #include <api/peer_connection_interface.h>
+#include <api/rtp_parameters.h>
 #include <api/create_peerconnection_factory.h>
 #include <api/media_stream_interface.h>
+#include <api/stats/rtc_stats_collector_callback.h>
+#include <api/packet_socket_factory.h>
 #include <rtc_base/thread.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
 
 // Forward declarations
+class EmulatedLink;
 class EncodedVideoSource;
 class PeerConnectionHandler;
 
-// Callback for sending signaling messages
+// Callback for sending signaling messages.
+// "answer" carries the raw SDP; "ice-candidate" carries a complete JSON
+// signaling message ({"type":"ice-candidate","candidate",...}).
 using SignalingCallback = std::function<void(const std::string& type, const std::string& message)>;
 
+// Outgoing stats of one video track of a session
+struct TrackStats {
+    std::string track_id;
+    int frame_width = 0;
+    int frame_height = 0;
+    double frames_per_second = 0;
+    uint64_t bytes_sent = 0;
+    uint32_t frames_encoded = 0;
+    double total_encode_time_s = 0;
+    double send_bitrate_bps = 0;                // Measured between the last two snapshots
+    double encode_ms_per_frame = 0;             // Between the last two snapshots
+};
+
+// Snapshot of the outgoing video stats of one session
+struct SessionStats {
+    int64_t timestamp_us = 0;
+    double available_outgoing_bitrate_bps = 0;  // Congestion controller estimate
+    double target_bitrate_bps = 0;              // Encoder target
+    uint64_t bytes_sent = 0;
+    double send_bitrate_bps = 0;                // Measured between the last two snapshots
+    double fraction_lost = 0;                   // Reported by the receiver (0.0 - 1.0)
+    double round_trip_time_s = 0;
+    std::string quality_limitation_reason;      // "none", "cpu", "bandwidth", "other"
+    uint32_t frames_encoded = 0;
+    double total_encode_time_s = 0;
+    double frames_per_second = 0;
+    double encode_ms_per_frame = 0;             // Between the last two snapshots
+    
+    // Video received from the peer (ingest)
+    uint64_t bytes_received = 0;
+    uint32_t frames_received = 0;
+    uint32_t frames_decoded = 0;
+    double total_decode_time_s = 0;
+    double receive_bitrate_bps = 0;             // Between the last two snapshots
+    double receive_fps = 0;
+    double decode_ms_per_frame = 0;
+    
+    // Everything the peer sent on the transport (media, RTCP, data channel)
+    uint64_t transport_bytes_received = 0;
+    double encode_cpu_cores = 0;                // Encode time per second, all tracks
+    
+    // Per sent video track, in track id order (the fields above sum them)
+    std::vector<TrackStats> tracks;
+};
+
+// Connection lifecycle of a session, from PeerConnectionObserver
+enum class SessionState { kNew, kConnecting, kConnected, kDisconnected, kFailed, kClosed };
+const char* SessionStateName(SessionState state);
+
+// Encoding settings requested by the adaptive quality controller
+struct QualitySettings {
+    double scale_resolution_down_by = 1.0;
+    double max_framerate = 0;
+    int max_bitrate_bps = 0;
+    webrtc::DegradationPreference degradation_preference = webrtc::DegradationPreference::BALANCED;
+};
+
+// What a hidden viewer (minimized tab, player off screen) still gets
+enum class HiddenMode {
+    kSuspend,    // Encodings inactive: no encoding, no egress
+    kThumbnail,  // One small, slow, low-bitrate layer (keeps a live preview)
+};
+
 // Observer for peer connection events
 class PeerObserver : public webrtc::PeerConnectionObserver {
 public:
@@ -29,6 +107,7 @@ public:
 
     void SetThroughputReceiver(std::shared_ptr<ThroughputReceiver> receiver);
     void SetPeerConnectionHandler(PeerConnectionHandler* handler);
+    void SetSessionId(const std::string& session_id);
 
     // PeerConnectionObserver implementation
     void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override;
@@ -37,11 +116,13 @@ public:
     void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
     void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override;
     void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
+    void OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) override;
     void OnTrack(rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) override;
 
 private:
     SignalingCallback signaling_callback_;
     std::shared_ptr<ThroughputReceiver> receiver_;
+    std::string session_id_;  // For log records
     bool answer_created_;
     bool gathering_complete_;
     PeerConnectionHandler* handler_;
@@ -82,13 +163,25 @@ private:
     std::function<void()> callback_;
 };
 
+class StatsObserver : public webrtc::RTCStatsCollectorCallback {
+public:
+    StatsObserver(std::function<void(const rtc::scoped_refptr<const webrtc::RTCStatsReport>&)> callback);
+    void OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override;
+
+private:
+    std::function<void(const rtc::scoped_refptr<const webrtc::RTCStatsReport>&)> callback_;
+};
+
 // Handles a single peer connection
 class PeerConnectionHandler {
 public:
+    // packet_socket_factory replaces the factory's sockets for this session
+    // only (EmulatedPacketSocketFactory impairs its network); null = default
     PeerConnectionHandler(
         rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory,
         std::shared_ptr<EncodedVideoSource> video_source,
-        SignalingCallback signaling_callback);
+        SignalingCallback signaling_callback,
+        std::unique_ptr<rtc::PacketSocketFactory> packet_socket_factory = nullptr);
     ~PeerConnectionHandler();
 
     // Handle incoming signaling messages
@@ -96,17 +189,153 @@ public:
     void HandleIceCandidate(const std::string& candidate, const std::string& sdp_mid, int sdp_mline_index);
     void CreateAnswer();  // Public so observer can call when gathering completes
     
+    // Send another video track on the same transport: own encoder, same
+    // stream, bitrate range from its source's resolution. Call before
+    // HandleOffer; the offer needs one video m-section per track.
+    bool AddVideoTrack(std::shared_ptr<EncodedVideoSource> source);
+    int GetTrackCount() const { return (video_sender_ ? 1 : 0) + static_cast<int>(extra_tracks_.size()); }
+    
+    // Apply start/min/max bitrates to the congestion controller and the video
+    // senders (the transport also gets the extra tracks' start and max)
+    void ApplyBitrateProfile(const BitrateProfile& profile);
+    
+    // Reconfigure every video sender's encoding (resolution, framerate, bitrate cap)
+    void ApplyQuality(const QualitySettings& quality);
+    
+    // Viewer's video hidden or shown again. Hiding saves each sender's
+    // encodings and suspends or shrinks them; showing restores them (plus
+    // any quality change that arrived meanwhile). Request a keyframe after
+    // showing so the picture is back at once.
+    void SetVisible(bool visible, HiddenMode mode);
+    bool IsHidden() const { return hidden_; }
+    
+    // Tags this session's log records. Set before HandleOffer.
+    void SetSessionId(const std::string& session_id);
+    const std::string& session_id() const { return session_id_; }
+    
+    // Force a keyframe on every video sender now (pace these through a
+    // KeyframeCoordinator when many sessions may ask at once)
+    void RequestKeyFrame();
+    
+    // Join timing: offer received -> connected (server side) and offer ->
+    // first frame shown (reported by the client); -1 until known
+    int64_t GetConnectMs() const { return connect_ms_; }
+    void SetFirstFrameMs(int64_t ms) { first_frame_ms_ = ms; }
+    int64_t GetFirstFrameMs() const { return first_frame_ms_; }
+    
+    // Request a stats snapshot (asynchronous; result via GetLatestStats)
+    void PollStats();
+    
+    // Open the pre-negotiated benchmark data channel and stream over it.
+    // Call before HandleOffer.
+    bool StartDataChannelBench(const DataChannelBenchConfig& config);
+    bool HasDataChannelBench() const { return data_streamer_ != nullptr; }
+    DataChannelBenchStats SampleDataChannelBench();
+    
+    // Record the compressed video sent to this viewer, one IVF file per
+    // track: the first to path, the others to path with "_track<N>" before
+    // the extension. Each file starts at its track's next keyframe; the
+    // caller should request one. Stopping takes the taps off the senders.
+    bool StartRecording(const std::string& path);
+    void StopRecording();
+    bool IsRecording() const { return !recordings_.empty(); }
+    uint64_t GetRecordedFrames() const;
+    uint64_t GetRecordingDrops() const;
+    
+    // Write an RtcEventLog of this session to a file until StopEventLog()
+    bool StartEventLog(const std::string& path);
+    void StopEventLog();
+    
     // Get stats
     std::shared_ptr<ThroughputReceiver> GetReceiver() { return receiver_; }
+    SessionStats GetLatestStats() const;
+    BitrateProfile GetBitrateProfile() const { return profile_; }
+    int GetSourceFps() const;
+    
+    // Connection state, time spent in it, and time since the peer last sent
+    // anything; the server reaps sessions that stay failed or silent
+    SessionState GetState() const { return static_cast<SessionState>(state_.load()); }
+    int64_t GetStateAgeMs() const;
+    int64_t GetIdleMs() const;
+    void OnConnectionStateChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state);
+    
+    // The emulated link of this session's sockets, so its delayed packets
+    // count toward the session's memory
+    void SetEmulatedLink(std::shared_ptr<const EmulatedLink> link) { emulated_link_ = std::move(link); }
+    
+    // Memory held for this session: encoder frame buffers and RTP packet
+    // history of each track (estimated from the sent resolution, or the
+    // source's while suspended), plus measured buffers that grow when
+    // something downstream stalls: the recorders' queues, the data
+    // channel's bufferedAmount and netem-delayed packets
+    size_t EstimateMemoryBytes() const;
+    
+    // Milliseconds from first media sent until the encoder target reached the
+    // profile's start bitrate; -1 while still ramping
+    int64_t GetTimeToTargetMs() const { return time_to_target_ms_; }
 
 private:
+    void OnStats(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report);
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> AddTrackForSource(EncodedVideoSource* source,
+                                                                     const std::string& track_id);
+    std::vector<webrtc::RtpSenderInterface*> GetVideoSenders() const;
     
+
     rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
     rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
     std::shared_ptr<EncodedVideoSource> video_source_;
     std::shared_ptr<ThroughputReceiver> receiver_;
     std::unique_ptr<PeerObserver> observer_;
     SignalingCallback signaling_callback_;
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
+    
+    // Tracks added with AddVideoTrack (time-to-target follows the first
+    // track only)
+    struct ExtraTrack {
+        std::shared_ptr<EncodedVideoSource> source;
+        rtc::scoped_refptr<webrtc::RtpSenderInterface> sender;
+        BitrateProfile profile;
+    };
+    std::vector<ExtraTrack> extra_tracks_;
+    
+    // Visibility: encodings saved while hidden, and a quality change to apply
+    // once shown again
+    std::atomic<bool> hidden_{false};
+    std::vector<std::vector<webrtc::RtpEncodingParameters>> saved_encodings_;
+    bool has_pending_quality_ = false;
+    QualitySettings pending_quality_;
+    
+    // Bitrate profile and ramp-up tracking
+    BitrateProfile profile_;
+    bool has_profile_ = false;
+    std::chrono::steady_clock::time_point media_start_time_;
+    bool media_started_ = false;
+    std::atomic<int64_t> time_to_target_ms_{-1};
+    
+    std::string session_id_;
+    std::atomic<int64_t> offer_received_ms_{0};
+    std::atomic<int64_t> connect_ms_{-1};
+    std::atomic<int64_t> first_frame_ms_{-1};
+    
+    // Written on the signaling thread, read by the reaper
+    std::atomic<int> state_{static_cast<int>(SessionState::kNew)};
+    std::atomic<int64_t> state_since_ms_{0};
+    std::atomic<int64_t> last_activity_ms_{0};
+    
+    mutable std::mutex stats_mutex_;
+    SessionStats latest_stats_;
+    
+    std::unique_ptr<DataChannelStreamer> data_streamer_;
+    std::shared_ptr<const EmulatedLink> emulated_link_;
+    
+    // One per video sender while recording: the tap installed on the sender
+    // and the file it feeds
+    struct TrackRecording {
+        rtc::scoped_refptr<webrtc::RtpSenderInterface> sender;
+        rtc::scoped_refptr<EncodedFrameTap> tap;
+        std::unique_ptr<IvfRecorder> recorder;
+    };
+    std::vector<TrackRecording> recordings_;
 };
 
 #endif // PEER_CONNECTION_HANDLER_H
@@ -0,0 +1,147 @@
+// quality_controller.cpp
+// Implementation of the adaptive quality controller
+
+#include "quality_controller.h"
+#include "async_logger.h"
+
+namespace {
+
+// One rung of the quality ladder, relative to the session's full quality
+struct LadderStep {
+    double scale_resolution_down_by;
+    double framerate_fraction;
+    double bitrate_fraction;  // Of the bitrate profile's max
+};
+
+// Bitrate goes first (cheapest to give up), then resolution, then frame rate
+const LadderStep kLadder[] = {
+    {1.0, 1.0, 1.00},
+    {1.0, 1.0, 0.70},
+    {1.5, 1.0, 0.50},
+    {2.0, 1.0, 0.35},
+    {2.0, 0.5, 0.25},
+    {3.0, 0.5, 0.15},
+    {4.0, 0.5, 0.10},
+};
+const int kMaxLevel = sizeof(kLadder) / sizeof(kLadder[0]) - 1;
+
+} // namespace
+
+AdaptiveQualityController::AdaptiveQualityController(QualityControllerConfig config)
+    : config_(config) {
+}
+
+void AdaptiveQualityController::Tick(
+    const std::map<std::string, std::shared_ptr<PeerConnectionHandler>>& sessions) {
+    last_cpu_ = cpu_meter_.Sample();
+    bool cpu_pressure = last_cpu_ > config_.cpu_high;
+    bool cpu_headroom = last_cpu_ < config_.cpu_low;
+
+    // Drop state of sessions that went away without RemoveSession
+    for (auto it = states_.begin(); it != states_.end();) {
+        it = sessions.count(it->first) ? std::next(it) : states_.erase(it);
+    }
+
+    std::string costliest_id;
+    PeerConnectionHandler* costliest = nullptr;
+    double highest_cost = -1;
+
+    for (const auto& [id, handler] : sessions) {
+        SessionState& state = states_[id];
+        if (state.hold_ticks > 0) {
+            state.hold_ticks--;
+        }
+
+        if (handler->IsHidden()) {
+            continue;  // Suspended or thumbnail; judged again once visible
+        }
+        SessionStats stats = handler->GetLatestStats();
+        if (stats.timestamp_us == 0 || stats.frames_encoded == 0) {
+            continue;  // Not streaming yet
+        }
+
+        int fps = handler->GetSourceFps();
+        double frame_interval_ms = fps > 0 ? 1000.0 / fps : 33.3;
+        bool limited_by_bandwidth = stats.quality_limitation_reason == "bandwidth";
+        bool limited_by_cpu = stats.quality_limitation_reason == "cpu";
+
+        bool network_bad = stats.fraction_lost > config_.loss_high ||
+                           stats.round_trip_time_s > config_.rtt_high_s ||
+                           limited_by_bandwidth;
+        bool encoder_bad = limited_by_cpu || stats.encode_ms_per_frame > 0.8 * frame_interval_ms;
+        bool good = stats.fraction_lost < config_.loss_low &&
+                    stats.round_trip_time_s < config_.rtt_low_s &&
+                    !limited_by_bandwidth && !limited_by_cpu &&
+                    stats.encode_ms_per_frame < 0.5 * frame_interval_ms &&
+                    cpu_headroom;
+
+        if (network_bad || encoder_bad) {
+            state.bad_ticks++;
+            state.good_ticks = 0;
+        } else if (good) {
+            state.good_ticks++;
+            state.bad_ticks = 0;
+        } else {
+            state.bad_ticks = 0;
+            state.good_ticks = 0;
+        }
+
+        if (state.hold_ticks == 0 && state.bad_ticks >= config_.down_after_ticks && state.level < kMaxLevel) {
+            SetLevel(id, handler.get(), &state, state.level + 1, network_bad ? "network" : "encoder");
+        } else if (state.hold_ticks == 0 && state.good_ticks >= config_.up_after_ticks && state.level > 0) {
+            SetLevel(id, handler.get(), &state, state.level - 1, "recovered");
+        }
+
+        double encode_cost = stats.encode_ms_per_frame * stats.frames_per_second;
+        if (state.hold_ticks == 0 && state.level < kMaxLevel && encode_cost > highest_cost) {
+            highest_cost = encode_cost;
+            costliest_id = id;
+            costliest = handler.get();
+        }
+    }
+
+    // Shed server load one viewer at a time
+    if (cpu_pressure && costliest) {
+        SessionState& state = states_[costliest_id];
+        SetLevel(costliest_id, costliest, &state, state.level + 1, "server-cpu");
+    }
+}
+
+void AdaptiveQualityController::RemoveSession(const std::string& session_id) {
+    states_.erase(session_id);
+}
+
+int AdaptiveQualityController::GetLevel(const std::string& session_id) const {
+    auto it = states_.find(session_id);
+    return it != states_.end() ? it->second.level : 0;
+}
+
+void AdaptiveQualityController::SetLevel(const std::string& session_id, PeerConnectionHandler* handler,
+                                         SessionState* state, int level, const char* reason) {
+    const LadderStep& step = kLadder[level];
+    BitrateProfile profile = handler->GetBitrateProfile();
+
+    QualitySettings quality;
+    quality.scale_resolution_down_by = step.scale_resolution_down_by;
+    quality.max_framerate = handler->GetSourceFps() * step.framerate_fraction;
+    quality.max_bitrate_bps = static_cast<int>(profile.max_bitrate_bps * step.bitrate_fraction);
+
+    // When the encoder can't keep up, let libwebrtc trade resolution for a
+    // smooth frame rate; otherwise keep its balanced default
+    std::string why = reason;
+    bool cpu_bound = why == "encoder" || why == "server-cpu";
+    quality.degradation_preference = (level > 0 && cpu_bound)
+        ? webrtc::DegradationPreference::MAINTAIN_FRAMERATE
+        : webrtc::DegradationPreference::BALANCED;
+
+    handler->ApplyQuality(quality);
+
+    LogRecord(LogLevel::kInfo, "quality-level").Session(session_id).Kv("from", state->level).Kv("to", level)
+        .Kv("reason", reason).Kv("scale_down", step.scale_resolution_down_by)
+        .Kv("fps", quality.max_framerate).Kv("max_mbps", quality.max_bitrate_bps / 1000000.0);
+
+    state->level = level;
+    state->bad_ticks = 0;
+    state->good_ticks = 0;
+    state->hold_ticks = config_.hold_ticks;
+}
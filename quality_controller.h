@@ -0,0 +1,66 @@
+// quality_controller.h
+// Closed-loop per-viewer quality adaptation driven by WebRTC stats
+
+#ifndef QUALITY_CONTROLLER_H
+#define QUALITY_CONTROLLER_H
+
+#include "cpu_usage.h"
+#include "peer_connection_handler.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+struct QualityControllerConfig {
+    // Server CPU utilization (fraction of all cores) that triggers degradation,
+    // and the level below which sessions may step back up
+    double cpu_high = 0.85;
+    double cpu_low = 0.65;
+
+    // Network thresholds
+    double loss_high = 0.05;
+    double loss_low = 0.01;
+    double rtt_high_s = 0.30;
+    double rtt_low_s = 0.15;
+
+    // Hysteresis, in one-second ticks
+    int down_after_ticks = 3;
+    int up_after_ticks = 10;
+    int hold_ticks = 5;  // Minimum time between two changes of one session
+};
+
+// Steps each sender up or down a quality ladder (bitrate cap, resolution
+// scale, frame rate cap) based on its own stats. Server CPU pressure
+// degrades one session per tick, the most expensive encoder first, so
+// viewers shed load gradually instead of all of them stuttering together.
+class AdaptiveQualityController {
+public:
+    explicit AdaptiveQualityController(QualityControllerConfig config = QualityControllerConfig());
+
+    // Called once per second with every live session
+    void Tick(const std::map<std::string, std::shared_ptr<PeerConnectionHandler>>& sessions);
+
+    void RemoveSession(const std::string& session_id);
+
+    // Current ladder level of a session (0 = full quality)
+    int GetLevel(const std::string& session_id) const;
+    double GetLastCpuUtilization() const { return last_cpu_; }
+
+private:
+    struct SessionState {
+        int level = 0;
+        int bad_ticks = 0;
+        int good_ticks = 0;
+        int hold_ticks = 0;
+    };
+
+    void SetLevel(const std::string& session_id, PeerConnectionHandler* handler,
+                  SessionState* state, int level, const char* reason);
+
+    QualityControllerConfig config_;
+    ProcessCpuMeter cpu_meter_;
+    double last_cpu_ = 0;
+    std::map<std::string, SessionState> states_;
+};
+
+#endif // QUALITY_CONTROLLER_H
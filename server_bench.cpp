@@ -0,0 +1,193 @@
+// server_bench.cpp
+// Microbenchmarks for the server's per-frame hot paths: test pattern fills,
+// VideoFrame building, broadcast to N sinks and ThroughputReceiver::OnFrame
+// under contention. Signaling JSON is covered by signaling_json_bench.
+//
+// Usage: server_bench [FILTER] > results.json
+//   FILTER runs only the benchmarks whose name contains it
+
+#include "bench_harness.h"
+#include "encoded_video_source.h"
+#include "frame_pyramid.h"
+#include "throughput_receiver.h"
+#include "video_source.h"
+
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <rtc_base/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Resolution {
+    const char* label;
+    int width;
+    int height;
+};
+
+const Resolution kResolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+// Stands in for a VideoStreamEncoder: takes the frame and touches its buffer
+class CountingSink : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
+public:
+    void OnFrame(const webrtc::VideoFrame& frame) override {
+        frames_++;
+        pixels_ += frame.width() * frame.height();
+    }
+    int64_t pixels() const { return pixels_; }
+
+private:
+    int64_t frames_ = 0;
+    int64_t pixels_ = 0;
+};
+
+// Runs fn calls_per_thread times on each of `threads` threads, all started
+// together; ns_per_op is the wall time per call as every thread sees it
+template <typename Fn>
+bench::Result RunThreaded(const std::string& name, int threads, int64_t calls_per_thread, Fn&& fn,
+                          int repetitions = 7) {
+    std::vector<double> samples;
+    for (int r = 0; r < repetitions; r++) {
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                ready++;
+                while (!go) {
+                }
+                for (int64_t i = 0; i < calls_per_thread; i++) fn();
+            });
+        }
+        while (ready < threads) {
+        }
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+        for (std::thread& worker : workers) worker.join();
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(elapsed_ns / calls_per_thread);
+    }
+    std::sort(samples.begin(), samples.end());
+    return bench::Result{name, calls_per_thread, samples[samples.size() / 2], samples.front(), samples.back(), 0};
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    auto wanted = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    // Keep libwebrtc's logging out of the JSON. ThroughputReceiver logs
+    // through AsyncLogger, which is never started here: its records wait in
+    // the ring and are dropped once it fills, so the benchmarks still pay
+    // the submit cost but nothing is written.
+    rtc::LogMessage::LogToDebug(rtc::LS_NONE);
+
+    std::vector<bench::Result> results;
+
+    // Pattern fills: TestVideoSource redraws every frame, EncodedVideoSource once
+    for (const Resolution& resolution : kResolutions) {
+        rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create(resolution.width, resolution.height);
+        double frame_bytes = resolution.width * resolution.height * 1.5;
+
+        std::string name = std::string("fill/test_pattern/") + resolution.label;
+        if (wanted(name)) {
+            std::cerr << name << std::endl;
+            int frame_index = 0;
+            results.push_back(bench::Run(name, frame_bytes, [&]() {
+                FillTestPattern(buffer.get(), frame_index++);
+                bench::DoNotOptimize(buffer->DataY()[0]);
+            }));
+        }
+        name = std::string("fill/gradient/") + resolution.label;
+        if (wanted(name)) {
+            std::cerr << name << std::endl;
+            results.push_back(bench::Run(name, frame_bytes, [&]() {
+                FillGradientPattern(buffer.get());
+                bench::DoNotOptimize(buffer->DataY()[0]);
+            }));
+        }
+    }
+
+    // Building one VideoFrame around the shared buffer (EncodedVideoSource's per-frame work)
+    {
+        rtc::scoped_refptr<webrtc::I420Buffer> base = webrtc::I420Buffer::Create(1920, 1080);
+        FillGradientPattern(base.get());
+        rtc::scoped_refptr<PyramidFrameBuffer> pyramid = PyramidFrameBuffer::Create(base);
+        int64_t timestamp_us = 0;
+        if (wanted("frame/build")) {
+            std::cerr << "frame/build" << std::endl;
+            results.push_back(bench::Run("frame/build", 0, [&]() {
+                webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                    .set_video_frame_buffer(pyramid)
+                    .set_timestamp_us(timestamp_us++)
+                    .set_update_rect(webrtc::VideoFrame::UpdateRect{0, 0, 0, 0})
+                    .build();
+                bench::DoNotOptimize(frame.timestamp_us());
+            }));
+        }
+
+        // Build plus broadcast to N sinks, at full resolution and with every
+        // sink asking for half the pixels (the pyramid scales once for all)
+        for (int sinks : {1, 8, 32}) {
+            for (bool downscale : {false, true}) {
+                std::string name = "frame/broadcast/" + std::to_string(sinks) + "_sinks" + (downscale ? "_half" : "");
+                if (!wanted(name)) continue;
+                std::cerr << name << std::endl;
+
+                AdaptingBroadcaster broadcaster;
+                std::vector<std::unique_ptr<CountingSink>> counting_sinks;
+                rtc::VideoSinkWants wants;
+                if (downscale) {
+                    wants.max_pixel_count = 1920 * 1080 / 2;
+                }
+                for (int i = 0; i < sinks; i++) {
+                    counting_sinks.push_back(std::make_unique<CountingSink>());
+                    broadcaster.AddOrUpdateSink(counting_sinks.back().get(), wants);
+                }
+                int64_t frame_interval_us = 1000000 / 30;
+                results.push_back(bench::Run(name, 0, [&]() {
+                    timestamp_us += frame_interval_us;  // Adapters drop frames that come too fast
+                    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                        .set_video_frame_buffer(pyramid)
+                        .set_timestamp_us(timestamp_us)
+                        .set_update_rect(webrtc::VideoFrame::UpdateRect{0, 0, 0, 0})
+                        .build();
+                    broadcaster.OnFrame(frame);
+                }));
+                for (auto& sink : counting_sinks) {
+                    broadcaster.RemoveSink(sink.get());
+                    bench::DoNotOptimize(sink->pixels());
+                }
+            }
+        }
+    }
+
+    // ThroughputReceiver::OnFrame from several decoder threads at once
+    {
+        rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create(1280, 720);
+        webrtc::VideoFrame frame = webrtc::VideoFrame::Builder().set_video_frame_buffer(buffer).build();
+        for (int threads : {1, 2, 4, 8}) {
+            std::string name = "receiver/on_frame/" + std::to_string(threads) + "_threads";
+            if (!wanted(name)) continue;
+            std::cerr << name << std::endl;
+            ThroughputReceiver receiver;
+            results.push_back(RunThreaded(name, threads, 200000, [&]() { receiver.OnFrame(frame); }));
+        }
+    }
+
+    bench::PrintJson(results);
+    return 0;
+}
@@ -0,0 +1,339 @@
+// signaling_json.cpp
+// Implementation of the signaling JSON tokenizer and escaper
+
+#include "signaling_json.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIGNALING_JSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+size_t SkipWhitespace(std::string_view s, size_t pos) {
+    while (pos < s.size() && IsWhitespace(s[pos])) pos++;
+    return pos;
+}
+
+// Finds the closing quote of a string whose contents start at pos.
+// Uses memchr to jump between quotes, so long SDP bodies are scanned in bulk.
+// Returns npos if unterminated; sets has_escapes if a backslash was seen.
+size_t FindStringEnd(std::string_view s, size_t pos, bool* has_escapes) {
+    *has_escapes = false;
+    size_t search = pos;
+    while (search < s.size()) {
+        const void* hit = std::memchr(s.data() + search, '"', s.size() - search);
+        if (!hit) return std::string_view::npos;
+
+        size_t quote = static_cast<const char*>(hit) - s.data();
+
+        // A quote is escaped only by an odd run of backslashes before it
+        size_t backslashes = 0;
+        while (quote - backslashes > pos && s[quote - backslashes - 1] == '\\') backslashes++;
+
+        if (backslashes > 0) *has_escapes = true;
+        if (backslashes % 2 == 0) {
+            if (!*has_escapes && std::memchr(s.data() + pos, '\\', quote - pos)) {
+                *has_escapes = true;
+            }
+            return quote;
+        }
+        search = quote + 1;
+    }
+    return std::string_view::npos;
+}
+
+// Skips a nested object or array starting at pos; returns the index past it
+size_t SkipContainer(std::string_view s, size_t pos) {
+    int depth = 0;
+    while (pos < s.size()) {
+        char c = s[pos];
+        if (c == '"') {
+            bool escapes;
+            size_t end = FindStringEnd(s, pos + 1, &escapes);
+            if (end == std::string_view::npos) return end;
+            pos = end + 1;
+            continue;
+        }
+        if (c == '{' || c == '[') depth++;
+        if (c == '}' || c == ']') {
+            depth--;
+            if (depth == 0) return pos + 1;
+        }
+        pos++;
+    }
+    return std::string_view::npos;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool ParseHex4(std::string_view s, size_t pos, uint32_t* value) {
+    if (pos + 4 > s.size()) return false;
+    uint32_t result = 0;
+    for (size_t i = 0; i < 4; i++) {
+        int digit = HexValue(s[pos + i]);
+        if (digit < 0) return false;
+        result = (result << 4) | static_cast<uint32_t>(digit);
+    }
+    *value = result;
+    return true;
+}
+
+void AppendUtf8(std::string* out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Escape sequence for each byte; empty for bytes that are copied verbatim
+const char* EscapeFor(unsigned char c) {
+    static const char* const kControl[32] = {
+        "\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+        "\\b",     "\\t",     "\\n",     "\\u000b", "\\f",     "\\r",     "\\u000e", "\\u000f",
+        "\\u0010", "\\u0011", "\\u0012", "\\u0013", "\\u0014", "\\u0015", "\\u0016", "\\u0017",
+        "\\u0018", "\\u0019", "\\u001a", "\\u001b", "\\u001c", "\\u001d", "\\u001e", "\\u001f"};
+    if (c < 0x20) return kControl[c];
+    if (c == '"') return "\\\"";
+    if (c == '\\') return "\\\\";
+    return nullptr;
+}
+
+#ifdef SIGNALING_JSON_SSE2
+int CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+} // namespace
+
+bool SignalingMessage::Parse(std::string_view body) {
+    fields_.clear();
+
+    size_t pos = SkipWhitespace(body, 0);
+    if (pos >= body.size() || body[pos] != '{') return false;
+    pos = SkipWhitespace(body, pos + 1);
+
+    if (pos < body.size() && body[pos] == '}') return true;
+
+    while (pos < body.size()) {
+        // Key
+        if (body[pos] != '"') break;
+        bool key_escapes;
+        size_t key_end = FindStringEnd(body, pos + 1, &key_escapes);
+        if (key_end == std::string_view::npos) break;
+        Field field;
+        field.key = body.substr(pos + 1, key_end - pos - 1);
+
+        pos = SkipWhitespace(body, key_end + 1);
+        if (pos >= body.size() || body[pos] != ':') break;
+        pos = SkipWhitespace(body, pos + 1);
+        if (pos >= body.size()) break;
+
+        // Value
+        char c = body[pos];
+        if (c == '"') {
+            size_t end = FindStringEnd(body, pos + 1, &field.has_escapes);
+            if (end == std::string_view::npos) break;
+            field.value = body.substr(pos + 1, end - pos - 1);
+            field.is_string = true;
+            pos = end + 1;
+        } else if (c == '{' || c == '[') {
+            size_t end = SkipContainer(body, pos);
+            if (end == std::string_view::npos) break;
+            field.value = body.substr(pos, end - pos);
+            field.is_string = false;
+            field.has_escapes = false;
+            pos = end;
+        } else {
+            size_t end = pos;
+            while (end < body.size() && body[end] != ',' && body[end] != '}' && !IsWhitespace(body[end])) end++;
+            field.value = body.substr(pos, end - pos);
+            field.is_string = false;
+            field.has_escapes = false;
+            pos = end;
+        }
+        fields_.push_back(field);
+
+        pos = SkipWhitespace(body, pos);
+        if (pos >= body.size()) break;
+        if (body[pos] == '}') return true;
+        if (body[pos] != ',') break;
+        pos = SkipWhitespace(body, pos + 1);
+    }
+
+    fields_.clear();
+    return false;
+}
+
+const SignalingMessage::Field* SignalingMessage::Find(std::string_view field) const {
+    // Signaling messages have a handful of fields, so a linear scan wins
+    for (const Field& f : fields_) {
+        if (f.key == field) return &f;
+    }
+    return nullptr;
+}
+
+std::string_view SignalingMessage::GetRaw(std::string_view field) const {
+    const Field* f = Find(field);
+    return f ? f->value : std::string_view();
+}
+
+std::string SignalingMessage::GetString(std::string_view field) const {
+    const Field* f = Find(field);
+    if (!f) return "";
+    if (!f->has_escapes) return std::string(f->value);
+
+    std::string result;
+    if (!UnescapeJsonString(f->value, &result)) return "";
+    return result;
+}
+
+int SignalingMessage::GetInt(std::string_view field, int fallback) const {
+    const Field* f = Find(field);
+    if (!f || f->value.empty()) return fallback;
+
+    std::string text(f->value);
+    char* end = nullptr;
+    long value = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str()) return fallback;
+    return static_cast<int>(value);
+}
+
+bool UnescapeJsonString(std::string_view raw, std::string* out) {
+    out->clear();
+    out->reserve(raw.size());
+
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        // Copy the run up to the next escape in one go
+        const void* hit = std::memchr(raw.data() + pos, '\\', raw.size() - pos);
+        size_t next = hit ? static_cast<const char*>(hit) - raw.data() : raw.size();
+        out->append(raw.data() + pos, next - pos);
+        if (next >= raw.size()) break;
+
+        if (next + 1 >= raw.size()) return false;
+        char c = raw[next + 1];
+        pos = next + 2;
+        switch (c) {
+            case '"': out->push_back('"'); break;
+            case '\\': out->push_back('\\'); break;
+            case '/': out->push_back('/'); break;
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                uint32_t code_point;
+                if (!ParseHex4(raw, pos, &code_point)) return false;
+                pos += 4;
+
+                // Combine UTF-16 surrogate pairs; lone surrogates become U+FFFD
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    uint32_t low;
+                    if (pos + 1 < raw.size() && raw[pos] == '\\' && raw[pos + 1] == 'u' &&
+                        ParseHex4(raw, pos + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        pos += 6;
+                    } else {
+                        code_point = 0xFFFD;
+                    }
+                } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    code_point = 0xFFFD;
+                }
+                AppendUtf8(out, code_point);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+void AppendEscapedJson(std::string* out, std::string_view str) {
+    // SDP escapes roughly two bytes per line, so reserve a little headroom
+    out->reserve(out->size() + str.size() + str.size() / 16 + 16);
+
+    const char* data = str.data();
+    size_t length = str.size();
+    size_t pos = 0;
+    size_t run_start = 0;
+
+#ifdef SIGNALING_JSON_SSE2
+    // Test 16 bytes at a time for '"', '\\' and control characters and
+    // copy clean blocks without looking at individual bytes
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    while (pos + 16 <= length) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i needs_escape = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(needs_escape));
+        if (mask == 0) {
+            pos += 16;
+            continue;
+        }
+        while (mask != 0) {
+            size_t index = pos + CountTrailingZeros(mask);
+            out->append(data + run_start, index - run_start);
+            out->append(EscapeFor(static_cast<unsigned char>(data[index])));
+            run_start = index + 1;
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#endif
+
+    for (; pos < length; pos++) {
+        const char* escape = EscapeFor(static_cast<unsigned char>(data[pos]));
+        if (escape) {
+            out->append(data + run_start, pos - run_start);
+            out->append(escape);
+            run_start = pos + 1;
+        }
+    }
+    out->append(data + run_start, length - run_start);
+}
+
+std::string EscapeJson(std::string_view str) {
+    std::string result;
+    AppendEscapedJson(&result, str);
+    return result;
+}
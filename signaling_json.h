@@ -0,0 +1,61 @@
+// signaling_json.h
+// Single-pass tokenizer and fast escaper for signaling JSON messages
+
+#ifndef SIGNALING_JSON_H
+#define SIGNALING_JSON_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A flat signaling message ({"type":"offer","sdp":"...","sessionId":"..."}).
+// The body is tokenized once; fields are kept as views into it and string
+// values are only unescaped when asked for. The body must outlive the message.
+class SignalingMessage {
+public:
+    SignalingMessage() = default;
+    explicit SignalingMessage(std::string_view body) { Parse(body); }
+
+    // Tokenizes a JSON object. Nested objects/arrays are kept as raw values.
+    // Returns false (and keeps no fields) on malformed input.
+    bool Parse(std::string_view body);
+
+    bool Has(std::string_view field) const { return Find(field) != nullptr; }
+
+    // Raw value token: string contents without quotes (still escaped),
+    // or the literal text of numbers, booleans, null, objects and arrays
+    std::string_view GetRaw(std::string_view field) const;
+
+    // Unescaped string value, or the literal text for non-strings.
+    // Missing fields return an empty string.
+    std::string GetString(std::string_view field) const;
+
+    // Integer value (accepts both 0 and "0"); returns fallback when absent
+    int GetInt(std::string_view field, int fallback = 0) const;
+
+    size_t size() const { return fields_.size(); }
+
+private:
+    struct Field {
+        std::string_view key;
+        std::string_view value;
+        bool is_string;
+        bool has_escapes;
+    };
+
+    const Field* Find(std::string_view field) const;
+
+    std::vector<Field> fields_;
+};
+
+// Decodes a JSON string body (without quotes) into UTF-8, including \uXXXX
+// escapes and surrogate pairs. Returns false on invalid escapes.
+bool UnescapeJsonString(std::string_view raw, std::string* out);
+
+// Appends str to out as the body of a JSON string (without quotes)
+void AppendEscapedJson(std::string* out, std::string_view str);
+
+// Escapes str for embedding in a JSON string
+std::string EscapeJson(std::string_view str);
+
+#endif // SIGNALING_JSON_H
@@ -0,0 +1,187 @@
+// signaling_json_bench.cpp
+// Microbenchmarks for signaling JSON parsing/escaping on realistic SDP payloads
+//
+// Usage: signaling_json_bench > results.json
+
+#include "bench_harness.h"
+#include "signaling_json.h"
+
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Previous implementation, kept as the baseline for comparison
+std::string LegacyExtractJsonField(const std::string& json, const std::string& field) {
+    std::string search = "\"" + field + "\"";
+    size_t pos = json.find(search);
+    if (pos == std::string::npos) return "";
+    pos += search.length();
+    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == ':')) pos++;
+    if (pos >= json.length()) return "";
+    if (json[pos] == '"') {
+        pos++;
+        size_t end = pos;
+        while (end < json.length()) {
+            if (json[end] == '"' && (end == pos || json[end-1] != '\\')) break;
+            end++;
+        }
+        if (end < json.length()) {
+            std::string result = json.substr(pos, end - pos);
+            const char* patterns[][2] = {{"\\n", "\n"}, {"\\r", "\r"}, {"\\\"", "\""}, {"\\\\", "\\"}};
+            for (auto& p : patterns) {
+                size_t escPos = 0;
+                while ((escPos = result.find(p[0], escPos)) != std::string::npos) {
+                    result.replace(escPos, 2, p[1]);
+                    escPos++;
+                }
+            }
+            return result;
+        }
+    } else if (isdigit(json[pos]) || json[pos] == '-') {
+        size_t end = pos;
+        while (end < json.length() && (isdigit(json[end]) || json[end] == '.' || json[end] == '-')) end++;
+        return json.substr(pos, end - pos);
+    }
+    return "";
+}
+
+std::string LegacyEscapeJson(const std::string& str) {
+    std::string result;
+    for (char c : str) {
+        if (c == '"') result += "\\\"";
+        else if (c == '\\') result += "\\\\";
+        else if (c == '\n') result += "\\n";
+        else if (c == '\r') result += "\\r";
+        else if (c == '\t') result += "\\t";
+        else result += c;
+    }
+    return result;
+}
+
+// Builds a Chrome-style SDP offer; more video sections and candidates make
+// it larger (one section ~ 3 KB)
+std::string MakeSdp(int video_sections, int candidates) {
+    std::string sdp =
+        "v=0\r\no=- 4611731400430051336 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"
+        "a=group:BUNDLE";
+    for (int m = 0; m < video_sections; m++) sdp += " " + std::to_string(m);
+    sdp += "\r\na=extmap-allow-mixed\r\na=msid-semantic: WMS\r\n";
+
+    for (int m = 0; m < video_sections; m++) {
+        sdp += "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 102 121 127 120 125 107 108 109 35 36 124 119 123\r\n"
+               "c=IN IP4 0.0.0.0\r\na=rtcp:9 IN IP4 0.0.0.0\r\n";
+        for (int c = 0; c < candidates; c++) {
+            sdp += "a=candidate:" + std::to_string(842163049 + c) + " 1 udp 1677729535 192.168.1." +
+                   std::to_string(10 + c) + " " + std::to_string(50000 + c) +
+                   " typ srflx raddr 0.0.0.0 rport 0 generation 0 network-cost 999\r\n";
+        }
+        sdp += "a=ice-ufrag:Ff3C\r\na=ice-pwd:5Hc6e0r0p1kF5Oq8jzpXJbD3\r\na=ice-options:trickle\r\n"
+               "a=fingerprint:sha-256 9B:52:87:2D:6C:4C:A8:1E:9A:7B:63:D4:28:2C:04:AF:19:7A:5E:1C:11:DE:C0:5B:86:5A:22:3C:5B:BF:54:0C\r\n"
+               "a=setup:actpass\r\na=mid:" + std::to_string(m) + "\r\n"
+               "a=extmap:1 urn:ietf:params:rtp-hdrext:toffset\r\n"
+               "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+               "a=extmap:3 urn:3gpp:video-orientation\r\n"
+               "a=extmap:4 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+               "a=extmap:5 http://www.webrtc.org/experiments/rtp-hdrext/playout-delay\r\n"
+               "a=recvonly\r\na=rtcp-mux\r\na=rtcp-rsize\r\n";
+        const char* codecs[] = {"VP8/90000", "rtx/90000", "VP9/90000", "rtx/90000", "VP9/90000", "rtx/90000",
+                                "H264/90000", "rtx/90000", "H264/90000", "rtx/90000", "AV1/90000", "rtx/90000",
+                                "red/90000", "rtx/90000", "ulpfec/90000"};
+        int pt = 96;
+        for (const char* codec : codecs) {
+            sdp += "a=rtpmap:" + std::to_string(pt) + " " + codec + "\r\n";
+            if (std::string(codec).rfind("rtx", 0) == 0) {
+                sdp += "a=fmtp:" + std::to_string(pt) + " apt=" + std::to_string(pt - 1) + "\r\n";
+            } else {
+                sdp += "a=rtcp-fb:" + std::to_string(pt) + " goog-remb\r\n"
+                       "a=rtcp-fb:" + std::to_string(pt) + " transport-cc\r\n"
+                       "a=rtcp-fb:" + std::to_string(pt) + " ccm fir\r\n"
+                       "a=rtcp-fb:" + std::to_string(pt) + " nack\r\n"
+                       "a=rtcp-fb:" + std::to_string(pt) + " nack pli\r\n";
+            }
+            pt++;
+        }
+    }
+    return sdp;
+}
+
+std::string MakeOfferMessage(const std::string& sdp) {
+    return "{\"type\":\"offer\",\"sdp\":\"" + LegacyEscapeJson(sdp) +
+           "\",\"sessionId\":\"1712345678901-k3j4h5g6f\"}";
+}
+
+} // namespace
+
+int main() {
+    struct Payload {
+        std::string label;
+        std::string sdp;
+    };
+    // Single-section offers with many candidates up to multi-section offers (~4-10 KB)
+    std::vector<Payload> payloads;
+    for (auto shape : {std::make_pair(1, 14), std::make_pair(2, 10), std::make_pair(3, 8)}) {
+        std::string sdp = MakeSdp(shape.first, shape.second);
+        payloads.push_back({std::to_string((sdp.size() + 512) / 1024) + "KB", sdp});
+    }
+
+    std::vector<bench::Result> results;
+    for (const Payload& p : payloads) {
+        std::cerr << "SDP " << p.label << ": " << p.sdp.size() << " bytes" << std::endl;
+        std::string body = MakeOfferMessage(p.sdp);
+        double bytes = static_cast<double>(body.size());
+
+        // The offer path reads type, sessionId and sdp
+        results.push_back(bench::Run("parse_offer/legacy/" + p.label, bytes, [&]() {
+            std::string type = LegacyExtractJsonField(body, "type");
+            std::string session = LegacyExtractJsonField(body, "sessionId");
+            std::string sdp = LegacyExtractJsonField(body, "sdp");
+            bench::DoNotOptimize(sdp.size() + type.size() + session.size());
+        }));
+        results.push_back(bench::Run("parse_offer/tokenizer/" + p.label, bytes, [&]() {
+            SignalingMessage message(body);
+            std::string type = message.GetString("type");
+            std::string session = message.GetString("sessionId");
+            std::string sdp = message.GetString("sdp");
+            bench::DoNotOptimize(sdp.size() + type.size() + session.size());
+        }));
+
+        double sdp_bytes = static_cast<double>(p.sdp.size());
+        results.push_back(bench::Run("escape_answer/legacy/" + p.label, sdp_bytes, [&]() {
+            std::string escaped = LegacyEscapeJson(p.sdp);
+            bench::DoNotOptimize(escaped.size());
+        }));
+        results.push_back(bench::Run("escape_answer/vectorized/" + p.label, sdp_bytes, [&]() {
+            std::string escaped = EscapeJson(p.sdp);
+            bench::DoNotOptimize(escaped.size());
+        }));
+    }
+
+    std::string candidate =
+        "{\"type\":\"ice-candidate\",\"candidate\":\"candidate:842163049 1 udp 1677729535 "
+        "192.168.1.10 50000 typ srflx raddr 0.0.0.0 rport 0 generation 0 ufrag Ff3C network-cost 999\","
+        "\"sdpMid\":\"0\",\"sdpMLineIndex\":0,\"sessionId\":\"1712345678901-k3j4h5g6f\"}";
+    results.push_back(bench::Run("parse_candidate/legacy", static_cast<double>(candidate.size()), [&]() {
+        std::string type = LegacyExtractJsonField(candidate, "type");
+        std::string session = LegacyExtractJsonField(candidate, "sessionId");
+        std::string c = LegacyExtractJsonField(candidate, "candidate");
+        std::string mid = LegacyExtractJsonField(candidate, "sdpMid");
+        std::string index = LegacyExtractJsonField(candidate, "sdpMLineIndex");
+        bench::DoNotOptimize(type.size() + session.size() + c.size() + mid.size() + index.size());
+    }));
+    results.push_back(bench::Run("parse_candidate/tokenizer", static_cast<double>(candidate.size()), [&]() {
+        SignalingMessage message(candidate);
+        std::string type = message.GetString("type");
+        std::string session = message.GetString("sessionId");
+        std::string c = message.GetString("candidate");
+        std::string mid = message.GetString("sdpMid");
+        int index = message.GetInt("sdpMLineIndex");
+        bench::DoNotOptimize(type.size() + session.size() + c.size() + mid.size() + index);
+    }));
+
+    bench::PrintJson(results);
+    return 0;
+}
@@ -0,0 +1,53 @@
+// simple_audio_factories.h
+// Empty audio codec factories for video-only servers
+
+#ifndef SIMPLE_AUDIO_FACTORIES_H
+#define SIMPLE_AUDIO_FACTORIES_H
+
+#include <api/audio_codecs/audio_decoder_factory.h>
+#include <api/audio_codecs/audio_encoder_factory.h>
+#include <memory>
+#include <vector>
+
+namespace webrtc {
+
+// Audio encoder factory that supports no codecs, so no audio is negotiated
+class EmptyAudioEncoderFactory : public AudioEncoderFactory {
+public:
+    std::vector<AudioCodecSpec> GetSupportedEncoders() override {
+        return {};
+    }
+
+    absl::optional<AudioCodecInfo> QueryAudioEncoder(const SdpAudioFormat& format) override {
+        return absl::nullopt;
+    }
+
+    std::unique_ptr<AudioEncoder> MakeAudioEncoder(
+        int payload_type,
+        const SdpAudioFormat& format,
+        absl::optional<AudioCodecPairId> codec_pair_id) override {
+        return nullptr;
+    }
+};
+
+// Audio decoder factory that supports no codecs
+class EmptyAudioDecoderFactory : public AudioDecoderFactory {
+public:
+    std::vector<AudioCodecSpec> GetSupportedDecoders() override {
+        return {};
+    }
+
+    bool IsSupportedDecoder(const SdpAudioFormat& format) override {
+        return false;
+    }
+
+    std::unique_ptr<AudioDecoder> MakeAudioDecoder(
+        const SdpAudioFormat& format,
+        absl::optional<AudioCodecPairId> codec_pair_id) override {
+        return nullptr;
+    }
+};
+
+} // namespace webrtc
+
+#endif // SIMPLE_AUDIO_FACTORIES_H
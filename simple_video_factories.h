@@ -7,17 +7,83 @@
 #include <api/video_codecs/video_encoder_factory.h>
 #include <api/video_codecs/video_decoder_factory.h>
 #include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_decoder.h>
 #include <api/video_codecs/vp8_temporal_layers.h>
 #include <modules/video_coding/codecs/vp8/include/vp8.h>
 #include <modules/video_coding/codecs/vp9/include/vp9.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 namespace webrtc {
 
+// Encoder wrapper that does not encode frames whose update_rect says
+// nothing changed. Keyframe requests are always honored, and one frame is
+// encoded at least every max_skip_ms so receivers and the bandwidth
+// estimator keep seeing the stream.
+class SkipUnchangedFramesEncoder : public VideoEncoder {
+public:
+    explicit SkipUnchangedFramesEncoder(std::unique_ptr<VideoEncoder> encoder, int64_t max_skip_ms = 1000)
+        : encoder_(std::move(encoder)), max_skip_ms_(max_skip_ms) {}
+
+    void SetFecControllerOverride(FecControllerOverride* fec_controller_override) override {
+        encoder_->SetFecControllerOverride(fec_controller_override);
+    }
+
+    int InitEncode(const VideoCodec* codec_settings, const VideoEncoder::Settings& settings) override {
+        last_encoded_ms_ = -1;
+        return encoder_->InitEncode(codec_settings, settings);
+    }
+
+    int32_t RegisterEncodeCompleteCallback(EncodedImageCallback* callback) override {
+        callback_ = callback;
+        return encoder_->RegisterEncodeCompleteCallback(callback);
+    }
+
+    int32_t Release() override { return encoder_->Release(); }
+
+    int32_t Encode(const VideoFrame& frame, const std::vector<VideoFrameType>* frame_types) override {
+        bool key_frame_requested = frame_types &&
+            std::find(frame_types->begin(), frame_types->end(), VideoFrameType::kVideoFrameKey) != frame_types->end();
+        bool unchanged = frame.has_update_rect() && frame.update_rect().IsEmpty();
+        int64_t now_ms = frame.render_time_ms();
+        
+        if (unchanged && !key_frame_requested && last_encoded_ms_ >= 0 &&
+            now_ms - last_encoded_ms_ < max_skip_ms_) {
+            if (callback_) {
+                callback_->OnDroppedFrame(EncodedImageCallback::DropReason::kDroppedByEncoder);
+            }
+            return WEBRTC_VIDEO_CODEC_OK;
+        }
+        
+        last_encoded_ms_ = now_ms;
+        return encoder_->Encode(frame, frame_types);
+    }
+
+    void SetRates(const RateControlParameters& parameters) override { encoder_->SetRates(parameters); }
+    void OnPacketLossRateUpdate(float packet_loss_rate) override { encoder_->OnPacketLossRateUpdate(packet_loss_rate); }
+    void OnRttUpdate(int64_t rtt_ms) override { encoder_->OnRttUpdate(rtt_ms); }
+    void OnLossNotification(const LossNotification& loss_notification) override {
+        encoder_->OnLossNotification(loss_notification);
+    }
+    EncoderInfo GetEncoderInfo() const override { return encoder_->GetEncoderInfo(); }
+
+private:
+    std::unique_ptr<VideoEncoder> encoder_;
+    EncodedImageCallback* callback_ = nullptr;
+    int64_t max_skip_ms_;
+    int64_t last_encoded_ms_ = -1;
+};
+
 // Video encoder factory that creates real VP8/VP9 encoders
 class SimpleVideoEncoderFactory : public VideoEncoderFactory {
 public:
+    // skip_unchanged_frames: wrap encoders in SkipUnchangedFramesEncoder
+    explicit SimpleVideoEncoderFactory(bool skip_unchanged_frames = false)
+        : skip_unchanged_frames_(skip_unchanged_frames) {}
+
     std::vector<SdpVideoFormat> GetSupportedFormats() const override {
         std::vector<SdpVideoFormat> formats;
         formats.push_back(SdpVideoFormat("VP8"));
@@ -26,14 +92,20 @@ public:
     }
 
     std::unique_ptr<VideoEncoder> CreateVideoEncoder(const SdpVideoFormat& format) override {
+        std::unique_ptr<VideoEncoder> encoder;
         if (format.name == "VP8") {
-            return VP8Encoder::Create();
+            encoder = VP8Encoder::Create();
+        } else if (format.name == "VP9") {
+            encoder = VP9Encoder::Create();
         }
-        if (format.name == "VP9") {
-            return VP9Encoder::Create();
+        if (encoder && skip_unchanged_frames_) {
+            return std::make_unique<SkipUnchangedFramesEncoder>(std::move(encoder));
         }
-        return nullptr;
+        return encoder;
     }
+
+private:
+    bool skip_unchanged_frames_;
 };
 
 // Video decoder factory that creates real VP8/VP9 decoders
@@ -57,6 +129,41 @@ public:
     }
 };
 
+// Decoder that accepts every frame and produces nothing. Receive streams
+// stay healthy (no keyframe requests for undecoded frames), so ingest can
+// be measured without paying for decoding.
+class NullVideoDecoder : public VideoDecoder {
+public:
+    bool Configure(const Settings& settings) override { return true; }
+
+    int32_t Decode(const EncodedImage& input_image, bool missing_frames, int64_t render_time_ms) override {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t RegisterDecodeCompleteCallback(DecodedImageCallback* callback) override {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+
+    const char* ImplementationName() const override { return "NullVideoDecoder"; }
+};
+
+// Video decoder factory for ingest measurements without decoding
+class NullVideoDecoderFactory : public VideoDecoderFactory {
+public:
+    std::vector<SdpVideoFormat> GetSupportedFormats() const override {
+        std::vector<SdpVideoFormat> formats;
+        formats.push_back(SdpVideoFormat("VP8"));
+        formats.push_back(SdpVideoFormat("VP9"));
+        return formats;
+    }
+
+    std::unique_ptr<VideoDecoder> CreateVideoDecoder(const SdpVideoFormat& format) override {
+        return std::make_unique<NullVideoDecoder>();
+    }
+};
+
 } // namespace webrtc
 
 #endif // SIMPLE_VIDEO_FACTORIES_H
@@ -0,0 +1,143 @@
+// synthetic_viewer.cpp
+// Implementation of the in-process synthetic viewer
+
+#include "synthetic_viewer.h"
+#include "peer_connection_handler.h"
+#include "signaling_json.h"
+
+#include <api/jsep.h>
+#include <api/rtp_transceiver_interface.h>
+#include <rtc_base/logging.h>
+
+SyntheticViewer::SyntheticViewer(rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory,
+                                 const std::string& codec, OfferCallback on_offer, CandidateCallback on_candidate)
+    : factory_(factory),
+      codec_(codec),
+      on_offer_(on_offer),
+      on_candidate_(on_candidate) {
+}
+
+SyntheticViewer::~SyntheticViewer() {
+    if (peer_connection_) {
+        peer_connection_->Close();
+    }
+}
+
+bool SyntheticViewer::Start() {
+    // Loopback only: no STUN, the server's host candidates are enough
+    webrtc::PeerConnectionInterface::RTCConfiguration config;
+    config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+    config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
+    config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+
+    webrtc::PeerConnectionDependencies dependencies(this);
+    auto pc_result = factory_->CreatePeerConnectionOrError(config, std::move(dependencies));
+    if (!pc_result.ok()) {
+        RTC_LOG(LS_ERROR) << "Synthetic viewer: failed to create peer connection: " << pc_result.error().message();
+        return false;
+    }
+    peer_connection_ = pc_result.MoveValue();
+
+    webrtc::RtpTransceiverInit init;
+    init.direction = webrtc::RtpTransceiverDirection::kRecvOnly;
+    auto result = peer_connection_->AddTransceiver(cricket::MEDIA_TYPE_VIDEO, init);
+    if (!result.ok()) {
+        RTC_LOG(LS_ERROR) << "Synthetic viewer: AddTransceiver failed: " << result.error().message();
+        return false;
+    }
+
+    if (!codec_.empty()) {
+        // Offer only the codec under test (plus RTX for it)
+        std::vector<webrtc::RtpCodecCapability> codecs;
+        for (const auto& capability : factory_->GetRtpReceiverCapabilities(cricket::MEDIA_TYPE_VIDEO).codecs) {
+            if (capability.name == codec_ || capability.name == "rtx") {
+                codecs.push_back(capability);
+            }
+        }
+        webrtc::RTCError error = result.value()->SetCodecPreferences(codecs);
+        if (!error.ok()) {
+            RTC_LOG(LS_ERROR) << "Synthetic viewer: codec " << codec_ << " not available: " << error.message();
+            return false;
+        }
+    }
+
+    auto create_observer = new rtc::RefCountedObject<CreateSDPObserver>(
+        [this](webrtc::SessionDescriptionInterface* desc) {
+            std::string sdp;
+            desc->ToString(&sdp);
+            auto set_observer = new rtc::RefCountedObject<SetSDPObserver>([this, sdp]() {
+                on_offer_(sdp);
+            });
+            peer_connection_->SetLocalDescription(set_observer, desc);
+        });
+    peer_connection_->CreateOffer(create_observer, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    return true;
+}
+
+void SyntheticViewer::OnSignaling(const std::string& type, const std::string& message) {
+    if (type == "answer") {
+        SetAnswer(message);
+    } else if (type == "ice-candidate") {
+        SignalingMessage parsed(message);
+        AddRemoteCandidate(parsed.GetString("candidate"), parsed.GetString("sdpMid"),
+                           parsed.GetInt("sdpMLineIndex"));
+    }
+}
+
+void SyntheticViewer::SetAnswer(const std::string& sdp) {
+    webrtc::SdpParseError error;
+    std::unique_ptr<webrtc::SessionDescriptionInterface> answer =
+        webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp, &error);
+    if (!answer) {
+        RTC_LOG(LS_ERROR) << "Synthetic viewer: failed to parse answer: " << error.description;
+        failed_ = true;
+        return;
+    }
+
+    auto set_observer = new rtc::RefCountedObject<SetSDPObserver>([this]() {
+        std::vector<PendingCandidate> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            has_answer_ = true;
+            pending.swap(pending_candidates_);
+        }
+        for (const PendingCandidate& candidate : pending) {
+            AddRemoteCandidate(candidate.candidate, candidate.sdp_mid, candidate.sdp_mline_index);
+        }
+    });
+    peer_connection_->SetRemoteDescription(set_observer, answer.release());
+}
+
+void SyntheticViewer::AddRemoteCandidate(const std::string& candidate, const std::string& sdp_mid,
+                                         int sdp_mline_index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!has_answer_) {
+            pending_candidates_.push_back({candidate, sdp_mid, sdp_mline_index});
+            return;
+        }
+    }
+
+    webrtc::SdpParseError error;
+    std::unique_ptr<webrtc::IceCandidateInterface> ice_candidate(
+        webrtc::CreateIceCandidate(sdp_mid, sdp_mline_index, candidate, &error));
+    if (!ice_candidate || !peer_connection_->AddIceCandidate(ice_candidate.get())) {
+        RTC_LOG(LS_WARNING) << "Synthetic viewer: failed to add candidate " << candidate;
+    }
+}
+
+void SyntheticViewer::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+    if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected ||
+        new_state == webrtc::PeerConnectionInterface::kIceConnectionCompleted) {
+        connected_ = true;
+    } else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionFailed) {
+        failed_ = true;
+    }
+}
+
+void SyntheticViewer::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
+    std::string sdp;
+    if (candidate->ToString(&sdp)) {
+        on_candidate_(sdp, candidate->sdp_mid(), candidate->sdp_mline_index());
+    }
+}
@@ -0,0 +1,76 @@
+// synthetic_viewer.h
+// In-process receive-only peer connection that stands in for a browser tab
+
+#ifndef SYNTHETIC_VIEWER_H
+#define SYNTHETIC_VIEWER_H
+
+#include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Receives the server's video over a real (loopback) PeerConnection, so a
+// sweep exercises the same encode, packetize, pace and send path as remote
+// viewers. Signaling is direct function calls instead of HTTP: the offer
+// goes to PeerConnectionHandler::HandleOffer, the answer and trickled
+// candidates come back through the handler's SignalingCallback.
+// Create the viewer from a factory that does not decode (FactoryOptions
+// decode_video = false) so viewers cost next to nothing.
+class SyntheticViewer : public webrtc::PeerConnectionObserver {
+public:
+    using OfferCallback = std::function<void(const std::string& sdp)>;
+    using CandidateCallback =
+        std::function<void(const std::string& candidate, const std::string& sdp_mid, int sdp_mline_index)>;
+
+    // codec: "VP8", "VP9", or empty to accept whatever the server prefers
+    SyntheticViewer(rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory, const std::string& codec,
+                    OfferCallback on_offer, CandidateCallback on_candidate);
+    ~SyntheticViewer() override;
+
+    // Adds a recvonly video transceiver and creates the offer
+    bool Start();
+
+    // Feed the handler's SignalingCallback here
+    void OnSignaling(const std::string& type, const std::string& message);
+
+    bool connected() const { return connected_; }
+    bool failed() const { return failed_; }
+
+    // PeerConnectionObserver implementation
+    void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override {}
+    void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
+    void OnRenegotiationNeeded() override {}
+    void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
+    void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override {}
+    void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
+
+private:
+    void SetAnswer(const std::string& sdp);
+    void AddRemoteCandidate(const std::string& candidate, const std::string& sdp_mid, int sdp_mline_index);
+
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+    std::string codec_;
+    OfferCallback on_offer_;
+    CandidateCallback on_candidate_;
+
+    // Candidates that arrive before the answer is applied
+    struct PendingCandidate {
+        std::string candidate;
+        std::string sdp_mid;
+        int sdp_mline_index;
+    };
+    std::mutex mutex_;
+    bool has_answer_ = false;
+    std::vector<PendingCandidate> pending_candidates_;
+
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> failed_{false};
+};
+
+#endif // SYNTHETIC_VIEWER_H
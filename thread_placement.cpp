@@ -0,0 +1,137 @@
+// thread_placement.cpp
+// Implementation of thread placement
+
+#include "thread_placement.h"
+
+#include <fstream>
+#include <set>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Linux truncates thread names to 15 characters
+const size_t kMaxThreadNameLength = 15;
+
+std::string ReadFirstLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+} // namespace
+
+bool ParseCpuList(const std::string& list, std::vector<int>* cpus) {
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first) return false;
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus->push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !cpus->empty();
+}
+
+bool ThreadPlacement::Parse(const std::string& spec, std::string* error) {
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ';')) {
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            *error = "expected CLASS=CPUS, got \"" + item + "\"";
+            return false;
+        }
+        
+        Rule rule;
+        rule.thread_class = item.substr(0, eq);
+        rule.name_prefix = rule.thread_class == "encoder" ? "EncoderQueue" : rule.thread_class;
+        rule.name_prefix = rule.name_prefix.substr(0, kMaxThreadNameLength);
+        
+        std::string cpus = item.substr(eq + 1);
+        if (cpus.compare(0, 4, "node") == 0) {
+            // CPUs of a NUMA node
+            std::string node_list = ReadFirstLine("/sys/devices/system/node/" + cpus + "/cpulist");
+            if (node_list.empty()) {
+                *error = "unknown NUMA node \"" + cpus + "\"";
+                return false;
+            }
+            cpus = node_list;
+        }
+        if (!ParseCpuList(cpus, &rule.cpus)) {
+            *error = "bad CPU list \"" + cpus + "\" for " + rule.thread_class;
+            return false;
+        }
+        rules_.push_back(rule);
+    }
+    return true;
+}
+
+void ThreadPlacement::Apply() {
+#ifdef __linux__
+    if (rules_.empty()) return;
+    
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return;
+    
+    std::set<int> live_tids;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        int tid = std::atoi(entry->d_name);
+        live_tids.insert(tid);
+        
+        // New threads briefly carry their creator's name, so a rename is
+        // treated like a new thread
+        std::string name = ReadFirstLine("/proc/self/task/" + std::string(entry->d_name) + "/comm");
+        auto seen = seen_threads_.find(tid);
+        if (seen != seen_threads_.end() && seen->second == name) continue;
+        
+        for (const Rule& rule : rules_) {
+            if (name.compare(0, rule.name_prefix.length(), rule.name_prefix) != 0) continue;
+            
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : rule.cpus) {
+                CPU_SET(cpu, &set);
+            }
+            if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+                std::cerr << "Failed to pin thread " << name << " (" << tid << ") to " << rule.thread_class
+                          << " CPUs" << std::endl;
+            }
+            break;
+        }
+        // Threads that match no rule are not looked at again until renamed
+        seen_threads_[tid] = name;
+    }
+    closedir(dir);
+    
+    // Forget exited threads so a reused tid gets placed again
+    for (auto it = seen_threads_.begin(); it != seen_threads_.end();) {
+        it = live_tids.count(it->first) ? std::next(it) : seen_threads_.erase(it);
+    }
+#endif
+}
+
+std::string ThreadPlacement::Describe() const {
+    std::string description;
+    for (const Rule& rule : rules_) {
+        if (!description.empty()) description += ", ";
+        description += rule.thread_class + " -> " + std::to_string(rule.cpus.size()) + " CPUs";
+    }
+    return description;
+}
@@ -0,0 +1,45 @@
+// thread_placement.h
+// Pins named server threads to CPU sets or NUMA nodes
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Placement spec, one rule per thread class separated by ';':
+//   network=0-3;worker=4-7;FrameGenerator=node1;encoder=8-15
+// The CPU list uses the kernel cpulist format ("0-3,8,10-11") or "nodeN"
+// for all CPUs of a NUMA node. A class matches every thread whose name
+// starts with it, so "network" also covers the shard threads "network-1".
+// "encoder" is an alias for libwebrtc's EncoderQueue threads, which also
+// covers the libvpx worker threads they spawn.
+//
+// Only Linux supports placement; elsewhere Apply() does nothing.
+class ThreadPlacement {
+public:
+    bool Parse(const std::string& spec, std::string* error);
+    bool empty() const { return rules_.empty(); }
+
+    // Pins every matching thread that has not been placed yet. Threads come
+    // and go with sessions (encoder queues), so this is called periodically.
+    void Apply();
+
+    std::string Describe() const;
+
+private:
+    struct Rule {
+        std::string thread_class;
+        std::string name_prefix;
+        std::vector<int> cpus;
+    };
+
+    std::vector<Rule> rules_;
+    std::map<int, std::string> seen_threads_;  // tid -> name when last placed
+};
+
+// Parses a kernel cpulist ("0-3,8,10-11"). Returns false on malformed input.
+bool ParseCpuList(const std::string& list, std::vector<int>* cpus);
+
+#endif // THREAD_PLACEMENT_H
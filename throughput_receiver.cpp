@@ -2,9 +2,8 @@
 // Implementation of throughput measurement receiver
 
 #include "throughput_receiver.h"
+#include "async_logger.h"
 #include <rtc_base/logging.h>
-#include <iostream>
-#include <iomanip>
 
 ThroughputReceiver::ThroughputReceiver()
     : frames_(0),
@@ -35,12 +34,11 @@ void ThroughputReceiver::PrintStats() {
         double mbps = (bytes_ * 8.0) / (elapsed * 1000000.0);
         double mbytes_total = bytes_ / (1024.0 * 1024.0);
         
-        std::cout << std::fixed << std::setprecision(2);
-        std::cout << "Frames: " << std::setw(6) << frames_
-                  << " | FPS: " << std::setw(6) << fps
-                  << " | Throughput: " << std::setw(8) << mbps << " Mbps"
-                  << " | Total: " << std::setw(8) << mbytes_total << " MB"
-                  << std::endl;
+        LogRecord(LogLevel::kInfo, "receive-stats").Session(session_id_)
+            .Kv("frames", frames_.load())
+            .Kv("fps", fps)
+            .Kv("mbps", mbps)
+            .Kv("total_mb", mbytes_total);
     }
 }
 
@@ -9,6 +9,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <string>
 
 // Receives video frames and measures throughput
 class ThroughputReceiver : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
@@ -19,7 +20,10 @@ public:
     // VideoSinkInterface implementation
     void OnFrame(const webrtc::VideoFrame& frame) override;
 
-    // Print current statistics
+    // Tags the stats records. Set before frames arrive.
+    void SetSessionId(const std::string& session_id) { session_id_ = session_id; }
+    
+    // Log current statistics (asynchronously; safe on the frame thread)
     void PrintStats();
     
     // Reset statistics
@@ -34,6 +38,7 @@ private:
     std::atomic<int> frames_;
     std::atomic<long long> bytes_;
     std::chrono::steady_clock::time_point start_;
+    std::string session_id_;
 };
 
 #endif // THROUGHPUT_RECEIVER_H
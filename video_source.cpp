@@ -7,6 +7,28 @@
 #include <chrono>
 
 #include <cstdint> // Required for uint8_t
+#include <cstring>
+
+void FillTestPattern(webrtc::I420Buffer* buffer, int frame_index) {
+    int width = buffer->width();
+    int height = buffer->height();
+    
+    // Y plane (luminance)
+    uint8_t* y_data = buffer->MutableDataY();
+    int y_size = width * height;
+    for (int i = 0; i < y_size; i++) {
+      uint8_t pix_val = static_cast<uint8_t>((i + frame_index) % 256);
+      if (((i / width) < (0.4 * height)) && ((i % width) < 0.4 * width)) {
+           pix_val =  static_cast<uint8_t>(std::rand() % 256);
+      }
+      y_data[i] = pix_val;
+    }
+    
+    // U and V planes (chrominance) - set to neutral gray
+    int uv_size = buffer->ChromaWidth() * buffer->ChromaHeight();
+    memset(buffer->MutableDataU(), 128, uv_size);
+    memset(buffer->MutableDataV(), 128, uv_size);
+}
 
 TestVideoSource::TestVideoSource(int width, int height, int fps)
     : width_(width),
@@ -39,12 +61,13 @@ TestVideoSource::~TestVideoSource() {
 void TestVideoSource::AddOrUpdateSink(
     rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
     const rtc::VideoSinkWants& wants) {
-    broadcaster_.AddOrUpdateSink(sink, wants);
+    broadcaster_.AddOrUpdateSink(delivery_queues_.Wrap(sink), wants);
 }
 
 void TestVideoSource::RemoveSink(
     rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
-    broadcaster_.RemoveSink(sink);
+    broadcaster_.RemoveSink(delivery_queues_.Find(sink));
+    delivery_queues_.Remove(sink);
 }
 
 void TestVideoSource::Start() {
@@ -91,30 +114,18 @@ void TestVideoSource::GenerateFrames() {
             webrtc::I420Buffer::Create(width_, height_);
         
         // Fill with gradient pattern for realistic data
-        // Y plane (luminance)
-        uint8_t* y_data = buffer->MutableDataY();
-        int y_size = width_ * height_;
-        for (int i = 0; i < y_size; i++) {
-          uint8_t pix_val = static_cast<uint8_t>((i + frames_sent_) % 256);
-          if (((i / width_) < (0.4 * height_)) && ((i % width_) < 0.4 * width_)) {
-               pix_val =  static_cast<uint8_t>(std::rand() % 256);
-          }
-          y_data[i] = pix_val;
-        }
-        
-        // U and V planes (chrominance) - set to neutral gray
-        int uv_size = buffer->ChromaWidth() * buffer->ChromaHeight();
-        memset(buffer->MutableDataU(), 128, uv_size);
-        memset(buffer->MutableDataV(), 128, uv_size);
+        FillTestPattern(buffer.get(), frames_sent_);
         
         // Create VideoFrame
         // Use microseconds since epoch for timestamp
         int64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count();
         
+        // The gradient shifts every frame, so the whole frame is dirty
         webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
             .set_video_frame_buffer(buffer)
             .set_timestamp_us(timestamp_us)
+            .set_update_rect(webrtc::VideoFrame::UpdateRect{0, 0, width_, height_})
             .build();
         
         // Broadcast frame to all sinks
@@ -4,6 +4,8 @@
 #ifndef VIDEO_SOURCE_H
 #define VIDEO_SOURCE_H
 
+#include "frame_delivery_queue.h"
+
 #include <api/video/video_frame.h>
 #include <api/video/i420_buffer.h>
 #include <api/media_stream_interface.h>
@@ -16,6 +18,10 @@
 #include <cstdlib> // Required for rand() and srand()
 #include <ctime>   // Required for time()
 
+// Fills a frame of the test pattern: a gradient that shifts with
+// frame_index, with random noise in the top-left 40% x 40% block
+void FillTestPattern(webrtc::I420Buffer* buffer, int frame_index);
+
 // Video track source that generates test frames
 // Inherits from VideoTrackSourceInterface for compatibility with CreateVideoTrack
 class TestVideoSource : public webrtc::VideoTrackSourceInterface {
@@ -29,6 +35,13 @@ public:
     
     // Get statistics
     int GetFramesSent() const { return frames_sent_; }
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+    int GetFps() const { return fps_; }
+    
+    // Queue frames per sink on their own threads (call before sinks are added)
+    void SetDeliveryQueue(const DeliveryQueueConfig& config) { delivery_queues_.Configure(config); }
+    std::vector<DeliveryQueueStats> GetDeliveryStats() const { return delivery_queues_.GetStats(); }
 
     // VideoSourceInterface implementation
     void AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink,
@@ -49,6 +62,9 @@ public:
     bool GetStats(Stats* stats) override { return false; }
     bool SupportsEncodedOutput() const override { return false; }
     void GenerateKeyFrame() override {}
+    
+    // Encoded output is tapped per sender (PeerConnectionHandler::StartRecording):
+    // a source feeds one encoder per viewer, whose streams can't share a sink
     void AddEncodedSink(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) override {}
     void RemoveEncodedSink(rtc::VideoSinkInterface<webrtc::RecordableEncodedFrame>* sink) override {}
     
@@ -79,6 +95,9 @@ private:
     // Broadcaster to distribute frames to sinks
     rtc::VideoBroadcaster broadcaster_;
     
+    // Optional per-sink queues between the broadcaster and the sinks
+    FrameDeliveryQueues delivery_queues_;
+    
     // Reference counting
     mutable webrtc::webrtc_impl::RefCounter ref_count_{0};
 };
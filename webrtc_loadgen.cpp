@@ -0,0 +1,730 @@
+// webrtc_loadgen.cpp
+// Headless load generator: N receive-only PeerConnections that signal
+// through the server's POST /signaling protocol, like client-cpp.html does
+//
+// Usage: webrtc_loadgen [--server=HOST:PORT] [--viewers=N] [--flags]
+// Example: webrtc_loadgen --server=10.0.0.5:9090 --viewers=1000 --ramp=20 --shards=8 --no-decode
+
+#include "cpu_usage.h"
+#include "factory_shard.h"
+#include "signaling_json.h"
+
+#include <api/frame_transformer_interface.h>
+#include <api/jsep.h>
+#include <api/peer_connection_interface.h>
+#include <api/rtp_transceiver_interface.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/thread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<bool> g_running(true);
+
+void SignalHandler(int signal) {
+    g_running = false;
+}
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Value of --name=value, or fallback (same convention as webrtc_server)
+std::string GetFlag(int argc, char* argv[], const std::string& name, const std::string& fallback = "") {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) {
+            return arg.substr(prefix.size());
+        }
+    }
+    return fallback;
+}
+
+bool HasFlag(int argc, char* argv[], const std::string& name) {
+    std::string flag = "--" + name;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == flag || arg.compare(0, flag.size() + 1, flag + "=") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Blocking HTTP/1.1 POST (the server answers and closes the connection).
+// Returns the response body, or an empty string on failure.
+std::string HttpPost(const std::string& host, const std::string& port, const std::string& path,
+                     const std::string& body) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return "";
+    }
+
+    int fd = -1;
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        fd = static_cast<int>(socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+        if (fd < 0) continue;
+        if (connect(fd, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) break;
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        close(fd);
+#endif
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) {
+        return "";
+    }
+
+    std::string request = "POST " + path + " HTTP/1.1\r\n"
+                          "Host: " + host + ":" + port + "\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body;
+#ifdef MSG_NOSIGNAL
+    const int send_flags = MSG_NOSIGNAL;  // A server that went away must not kill us with SIGPIPE
+#else
+    const int send_flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < request.size()) {
+        int n = send(fd, request.data() + sent, static_cast<int>(request.size() - sent), send_flags);
+        if (n <= 0) break;
+        sent += n;
+    }
+
+    std::string response;
+    char buffer[8192];
+    while (true) {
+        int n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        response.append(buffer, n);
+    }
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+
+    size_t body_pos = response.find("\r\n\r\n");
+    return body_pos != std::string::npos ? response.substr(body_pos + 4) : "";
+}
+
+// Receive-side frame transformer that only timestamps assembled frames on
+// their way to the decoder. Works with and without decoding, and costs no
+// copy. A freeze is an inter-frame gap above max(3x, +150 ms) the average
+// gap, as in the WebRTC stats definition (average smoothed here).
+class FrameArrivalMonitor : public webrtc::FrameTransformerInterface {
+public:
+    struct Snapshot {
+        int64_t first_frame_us = 0;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        int freezes = 0;
+        double freeze_seconds = 0;
+    };
+
+    void Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) override {
+        int64_t now_us = NowUs();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stats_.frames == 0) {
+                stats_.first_frame_us = now_us;
+            } else {
+                double gap_ms = (now_us - last_frame_us_) / 1000.0;
+                if (stats_.frames > kWarmupFrames &&
+                    gap_ms > std::max(3 * average_gap_ms_, average_gap_ms_ + 150)) {
+                    stats_.freezes++;
+                    stats_.freeze_seconds += gap_ms / 1000.0;
+                }
+                average_gap_ms_ = stats_.frames == 1 ? gap_ms : 0.9 * average_gap_ms_ + 0.1 * gap_ms;
+            }
+            last_frame_us_ = now_us;
+            stats_.frames++;
+            stats_.bytes += frame->GetData().size();
+        }
+
+        rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback;
+        {
+            std::lock_guard<std::mutex> lock(callback_mutex_);
+            auto it = ssrc_callbacks_.find(frame->GetSsrc());
+            callback = it != ssrc_callbacks_.end() ? it->second : callback_;
+        }
+        if (callback) {
+            callback->OnTransformedFrame(std::move(frame));
+        }
+    }
+
+    void RegisterTransformedFrameCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) override {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        callback_ = callback;
+    }
+    void RegisterTransformedFrameSinkCallback(rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+                                              uint32_t ssrc) override {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        ssrc_callbacks_[ssrc] = callback;
+    }
+    void UnregisterTransformedFrameCallback() override {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        callback_ = nullptr;
+    }
+    void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        ssrc_callbacks_.erase(ssrc);
+    }
+
+    Snapshot Sample() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static constexpr uint64_t kWarmupFrames = 10;
+
+    mutable std::mutex mutex_;
+    Snapshot stats_;
+    int64_t last_frame_us_ = 0;
+    double average_gap_ms_ = 0;
+
+    std::mutex callback_mutex_;
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback_;
+    std::map<uint32_t, rtc::scoped_refptr<webrtc::TransformedFrameCallback>> ssrc_callbacks_;
+};
+
+// Sends signaling POSTs from a pool of threads, so a slow server never
+// blocks the WebRTC threads and one viewer's offer (which waits for the
+// answer) doesn't hold up the others queued behind it
+class SignalingClient {
+public:
+    SignalingClient(const std::string& host, const std::string& port, int threads)
+        : host_(host), port_(port) {
+        for (int i = 0; i < std::max(1, threads); i++) {
+            workers_.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    ~SignalingClient() { Stop(); }
+
+    // Pending posts are dropped; send closes with PostNow first
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            pending_.clear();
+        }
+        cv_.notify_all();
+        for (std::thread& worker : workers_) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    // sent runs on the worker right before the request goes out
+    void Post(const std::string& body, std::function<void(const std::string& response)> done = nullptr,
+              std::function<void()> sent = nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            pending_.push_back({body, std::move(done), std::move(sent)});
+        }
+        cv_.notify_one();
+    }
+
+    std::string PostNow(const std::string& body) { return HttpPost(host_, port_, "/signaling", body); }
+
+private:
+    struct Request {
+        std::string body;
+        std::function<void(const std::string& response)> done;
+        std::function<void()> sent;
+    };
+
+    void WorkerLoop() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+                if (stopping_) return;
+                request = std::move(pending_.front());
+                pending_.pop_front();
+            }
+            if (request.sent) request.sent();
+            std::string response = HttpPost(host_, port_, "/signaling", request.body);
+            if (request.done) request.done(response);
+        }
+    }
+
+    std::string host_;
+    std::string port_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> pending_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+class SetDescriptionObserver : public webrtc::SetSessionDescriptionObserver {
+public:
+    SetDescriptionObserver(std::function<void(bool ok, const std::string& error)> callback)
+        : callback_(callback) {}
+    void OnSuccess() override { callback_(true, ""); }
+    void OnFailure(webrtc::RTCError error) override { callback_(false, error.message()); }
+
+private:
+    std::function<void(bool ok, const std::string& error)> callback_;
+};
+
+class CreateDescriptionObserver : public webrtc::CreateSessionDescriptionObserver {
+public:
+    CreateDescriptionObserver(std::function<void(webrtc::SessionDescriptionInterface* desc)> callback)
+        : callback_(callback) {}
+    void OnSuccess(webrtc::SessionDescriptionInterface* desc) override { callback_(desc); }
+    void OnFailure(webrtc::RTCError error) override { callback_(nullptr); }
+
+private:
+    std::function<void(webrtc::SessionDescriptionInterface* desc)> callback_;
+};
+
+// One simulated viewer: receive-only, N video m-sections on one transport
+class LoadViewer : public webrtc::PeerConnectionObserver {
+public:
+    LoadViewer(int index, const std::string& session_id, FactoryShard* shard, SignalingClient* signaling)
+        : index_(index), session_id_(session_id), shard_(shard), signaling_(signaling) {}
+
+    ~LoadViewer() override { Close(); }
+
+    // netem: impairment spec for the server to apply to this session (empty = none)
+    bool Start(int tracks, const std::string& netem) {
+        webrtc::PeerConnectionInterface::RTCConfiguration config;
+        config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+        config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
+        config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+
+        webrtc::PeerConnectionDependencies dependencies(this);
+        auto pc_result = shard_->factory()->CreatePeerConnectionOrError(config, std::move(dependencies));
+        if (!pc_result.ok()) {
+            Fail("CreatePeerConnection failed: " + std::string(pc_result.error().message()));
+            return false;
+        }
+        peer_connection_ = pc_result.MoveValue();
+
+        for (int i = 0; i < tracks; i++) {
+            webrtc::RtpTransceiverInit init;
+            init.direction = webrtc::RtpTransceiverDirection::kRecvOnly;
+            auto result = peer_connection_->AddTransceiver(cricket::MEDIA_TYPE_VIDEO, init);
+            if (!result.ok()) {
+                Fail("AddTransceiver failed: " + std::string(result.error().message()));
+                return false;
+            }
+            auto monitor = rtc::make_ref_counted<FrameArrivalMonitor>();
+            result.value()->receiver()->SetDepacketizerToDecoderFrameTransformer(monitor);
+            monitors_.push_back(monitor);
+        }
+
+        auto create_observer = rtc::make_ref_counted<CreateDescriptionObserver>(
+            [this](webrtc::SessionDescriptionInterface* desc) {
+                if (!desc) {
+                    Fail("CreateOffer failed");
+                    return;
+                }
+                std::string sdp;
+                desc->ToString(&sdp);
+                auto set_observer = rtc::make_ref_counted<SetDescriptionObserver>(
+                    [this, sdp, netem](bool ok, const std::string& error) {
+                        if (!ok) {
+                            Fail("SetLocalDescription failed: " + error);
+                            return;
+                        }
+                        std::string body = "{\"type\":\"offer\",\"sessionId\":\"" + session_id_ +
+                                           "\",\"clientId\":\"" + session_id_ + "\",";
+                        if (!netem.empty()) {
+                            body += "\"netem\":\"";
+                            AppendEscapedJson(&body, netem);
+                            body += "\",";
+                        }
+                        body += "\"sdp\":\"";
+                        AppendEscapedJson(&body, sdp);
+                        body += "\"}";
+                        // Join time starts when the offer leaves, not while it
+                        // waits for a free signaling thread
+                        signaling_->Post(body, [this](const std::string& response) { OnAnswer(response); },
+                                         [this]() { start_us_ = NowUs(); });
+                    });
+                peer_connection_->SetLocalDescription(set_observer.get(), desc);
+            });
+        peer_connection_->CreateOffer(create_observer.get(), webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+        return true;
+    }
+
+    // Tells the server and closes the connection (blocking)
+    void Close() {
+        if (!peer_connection_) return;
+        signaling_->PostNow("{\"type\":\"close\",\"sessionId\":\"" + session_id_ + "\"}");
+        peer_connection_->Close();
+        peer_connection_ = nullptr;
+    }
+
+    struct Stats {
+        int index = 0;
+        std::string session_id;
+        bool connected = false;
+        std::string error;
+        int64_t join_ms = -1;        // Offer sent -> first frame
+        double receiving_seconds = 0;  // First frame -> now
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        int freezes = 0;
+        double freeze_seconds = 0;
+    };
+
+    Stats Sample() const {
+        Stats stats;
+        stats.index = index_;
+        stats.session_id = session_id_;
+        stats.connected = connected_;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats.error = error_;
+        }
+        int64_t first_frame_us = 0;
+        for (const auto& monitor : monitors_) {
+            FrameArrivalMonitor::Snapshot snapshot = monitor->Sample();
+            if (snapshot.frames > 0 && (first_frame_us == 0 || snapshot.first_frame_us < first_frame_us)) {
+                first_frame_us = snapshot.first_frame_us;
+            }
+            stats.frames += snapshot.frames;
+            stats.bytes += snapshot.bytes;
+            stats.freezes += snapshot.freezes;
+            stats.freeze_seconds += snapshot.freeze_seconds;
+        }
+        if (first_frame_us > 0) {
+            stats.join_ms = (first_frame_us - start_us_) / 1000;
+            stats.receiving_seconds = (NowUs() - first_frame_us) / 1000000.0;
+        }
+        return stats;
+    }
+
+    // PeerConnectionObserver implementation
+    void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override {}
+    void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
+    void OnRenegotiationNeeded() override {}
+    void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override {}
+
+    void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override {
+        if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected ||
+            new_state == webrtc::PeerConnectionInterface::kIceConnectionCompleted) {
+            connected_ = true;
+        } else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionFailed) {
+            connected_ = false;
+            Fail("ICE failed");
+        }
+    }
+
+    // Tells the server this viewer's time to first frame, once (call from
+    // the report loop with a fresh Sample)
+    void ReportFirstFrame(const Stats& stats) {
+        if (first_frame_reported_ || stats.join_ms < 0) return;
+        first_frame_reported_ = true;
+        signaling_->Post("{\"type\":\"first-frame\",\"sessionId\":\"" + session_id_ +
+                         "\",\"ms\":" + std::to_string(stats.join_ms) + "}");
+    }
+
+    void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override {
+        std::string sdp;
+        if (!candidate->ToString(&sdp)) return;
+        std::string body = "{\"type\":\"ice-candidate\",\"sessionId\":\"" + session_id_ + "\",\"candidate\":\"" +
+                           sdp + "\",\"sdpMid\":\"" + candidate->sdp_mid() +
+                           "\",\"sdpMLineIndex\":" + std::to_string(candidate->sdp_mline_index()) + "}";
+
+        // The server only knows the session once it has answered the offer
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (answered_) {
+            signaling_->Post(body);
+        } else {
+            pending_candidates_.push_back(body);
+        }
+    }
+
+private:
+    void OnAnswer(const std::string& response) {
+        SignalingMessage message(response);
+        if (message.GetString("type") != "answer") {
+            Fail(response.empty() ? "no response from server" : "server: " + message.GetString("message"));
+            return;
+        }
+
+        std::string sdp = message.GetString("sdp");
+        webrtc::SdpParseError parse_error;
+        std::unique_ptr<webrtc::SessionDescriptionInterface> answer =
+            webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp, &parse_error);
+        if (!answer) {
+            Fail("bad answer: " + parse_error.description);
+            return;
+        }
+        auto set_observer = rtc::make_ref_counted<SetDescriptionObserver>(
+            [this](bool ok, const std::string& error) {
+                if (!ok) {
+                    Fail("SetRemoteDescription failed: " + error);
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                answered_ = true;
+                for (const std::string& body : pending_candidates_) {
+                    signaling_->Post(body);
+                }
+                pending_candidates_.clear();
+            });
+        peer_connection_->SetRemoteDescription(set_observer.get(), answer.release());
+    }
+
+    void Fail(const std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) {
+            error_ = error;
+            std::cerr << "Viewer " << index_ << ": " << error << std::endl;
+        }
+    }
+
+    int index_;
+    std::string session_id_;
+    FactoryShard* shard_;
+    SignalingClient* signaling_;
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+    std::vector<rtc::scoped_refptr<FrameArrivalMonitor>> monitors_;
+    std::atomic<int64_t> start_us_{0};
+    bool first_frame_reported_ = false;
+    std::atomic<bool> connected_{false};
+
+    mutable std::mutex mutex_;
+    bool answered_ = false;
+    std::vector<std::string> pending_candidates_;
+    std::string error_;
+};
+
+int64_t Percentile(std::vector<int64_t> values, double fraction) {
+    if (values.empty()) return -1;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (HasFlag(argc, argv, "help")) {
+        std::cout << "Usage: " << argv[0] << " [--flags]\n";
+        std::cout << "  --server=HOST:PORT  webrtc_server to load (default 127.0.0.1:9090)\n";
+        std::cout << "  --viewers=N         Number of viewers (default 10)\n";
+        std::cout << "  --ramp=R            Viewers started per second (default 10)\n";
+        std::cout << "  --duration=S        Seconds to run after the last viewer started; 0 = until Ctrl+C (default 60)\n";
+        std::cout << "  --tracks=N          Video m-sections per viewer, to match the server's --tracks (default 1)\n";
+        std::cout << "  --shards=K          Spread viewers over K peer connection factories (default 1)\n";
+        std::cout << "  --signaling-threads=N  Signaling requests in flight at once (default 8)\n";
+        std::cout << "  --netem=SPEC        Ask the server to impair each viewer's downlink (server needs --netem-client)\n";
+        std::cout << "  --no-decode         Count frames without decoding them\n";
+        std::cout << "  --report=FILE       Per-viewer JSON report (default loadgen_report.json)\n";
+        return 0;
+    }
+
+    std::string server = GetFlag(argc, argv, "server", "127.0.0.1:9090");
+    size_t colon = server.rfind(':');
+    std::string host = colon == std::string::npos ? server : server.substr(0, colon);
+    std::string port = colon == std::string::npos ? "9090" : server.substr(colon + 1);
+    int num_viewers = std::max(1, std::atoi(GetFlag(argc, argv, "viewers", "10").c_str()));
+    double ramp = std::max(0.1, std::atof(GetFlag(argc, argv, "ramp", "10").c_str()));
+    int duration_s = std::max(0, std::atoi(GetFlag(argc, argv, "duration", "60").c_str()));
+    int tracks = std::max(1, std::atoi(GetFlag(argc, argv, "tracks", "1").c_str()));
+    int num_shards = std::max(1, std::atoi(GetFlag(argc, argv, "shards", "1").c_str()));
+    std::string report_path = GetFlag(argc, argv, "report", "loadgen_report.json");
+    std::string netem = GetFlag(argc, argv, "netem");
+
+    FactoryOptions options;
+    options.video_only = true;
+    options.decode_video = !HasFlag(argc, argv, "no-decode");
+
+    std::cout << "========================================\n";
+    std::cout << "WebRTC Load Generator\n";
+    std::cout << "========================================\n";
+    std::cout << "Server: " << host << ":" << port << "\n";
+    std::cout << "Viewers: " << num_viewers << " (" << ramp << "/s), " << tracks << " track" << (tracks > 1 ? "s" : "")
+              << " each\n";
+    if (!netem.empty()) {
+        std::cout << "Network emulation: " << netem << "\n";
+    }
+    std::cout << "Factories: " << num_shards << ", decoding " << (options.decode_video ? "on" : "off") << "\n";
+    std::cout << "========================================\n\n";
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 1;
+    }
+#endif
+
+    signal(SIGINT, SignalHandler);
+    signal(SIGTERM, SignalHandler);
+
+    FactoryShardPool shards;
+    if (!shards.Start(num_shards, options)) {
+        std::cerr << "Failed to create peer connection factories" << std::endl;
+        return 1;
+    }
+
+    SignalingClient signaling(host, port, std::atoi(GetFlag(argc, argv, "signaling-threads", "8").c_str()));
+    std::vector<std::unique_ptr<LoadViewer>> viewers;
+    std::string run_id = std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 1000000000);
+
+    ProcessCpuMeter cpu;
+    auto start = std::chrono::steady_clock::now();
+    auto next_report = start + std::chrono::seconds(5);
+    std::chrono::steady_clock::time_point ramp_done;
+    uint64_t last_bytes = 0;
+    uint64_t last_frames = 0;
+    auto last_report = start;
+
+    while (g_running) {
+        auto now = std::chrono::steady_clock::now();
+
+        // Ramp: start as many viewers as the elapsed time allows
+        double elapsed_s = std::chrono::duration<double>(now - start).count();
+        int due = std::min(num_viewers, 1 + static_cast<int>(elapsed_s * ramp));
+        while (static_cast<int>(viewers.size()) < due) {
+            int index = static_cast<int>(viewers.size());
+            auto viewer = std::make_unique<LoadViewer>(index, "loadgen-" + run_id + "-" + std::to_string(index),
+                                                       shards.Acquire(), &signaling);
+            viewer->Start(tracks, netem);
+            viewers.push_back(std::move(viewer));
+            if (static_cast<int>(viewers.size()) == num_viewers) {
+                ramp_done = now;
+            }
+        }
+
+        if (now >= next_report) {
+            int connected = 0, joined = 0, failed = 0, freezes = 0;
+            uint64_t bytes = 0, frames = 0;
+            for (const auto& viewer : viewers) {
+                LoadViewer::Stats stats = viewer->Sample();
+                viewer->ReportFirstFrame(stats);
+                connected += stats.connected ? 1 : 0;
+                joined += stats.join_ms >= 0 ? 1 : 0;
+                failed += stats.error.empty() ? 0 : 1;
+                freezes += stats.freezes;
+                bytes += stats.bytes;
+                frames += stats.frames;
+            }
+            double interval_s = std::chrono::duration<double>(now - last_report).count();
+            std::cout << "[" << static_cast<int>(elapsed_s) << "s] viewers " << viewers.size() << "/" << num_viewers
+                      << ", connected " << connected << ", receiving " << joined << ", failed " << failed
+                      << " | " << (bytes - last_bytes) * 8 / interval_s / 1000000.0 << " Mbps, "
+                      << (joined > 0 ? (frames - last_frames) / interval_s / joined / tracks : 0) << " fps/track"
+                      << ", freezes " << freezes << " | loadgen CPU " << cpu.SampleCores() << " cores" << std::endl;
+            last_bytes = bytes;
+            last_frames = frames;
+            last_report = now;
+            next_report += std::chrono::seconds(5);
+        }
+
+        if (static_cast<int>(viewers.size()) == num_viewers && duration_s > 0 &&
+            now - ramp_done >= std::chrono::seconds(duration_s)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    // Final per-viewer numbers, rates over the time each viewer was receiving
+    double run_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<LoadViewer::Stats> results;
+    for (const auto& viewer : viewers) {
+        results.push_back(viewer->Sample());
+    }
+
+    std::cout << "\nClosing " << viewers.size() << " viewers...\n";
+    for (auto& viewer : viewers) {
+        viewer->Close();
+    }
+    signaling.Stop();
+    viewers.clear();
+    shards.Stop();
+
+    std::vector<int64_t> join_ms;
+    std::vector<int64_t> fps_per_viewer;
+    int receiving = 0, total_freezes = 0;
+    double total_mbps = 0;
+
+    std::ofstream report(report_path);
+    report << std::fixed << std::setprecision(2);
+    report << "{\n";
+    report << "  \"server\": \"" << EscapeJson(server) << "\", \"viewers\": " << num_viewers
+           << ", \"tracks\": " << tracks << ", \"decode\": " << (options.decode_video ? "true" : "false")
+           << ", \"seconds\": " << run_seconds << ",\n";
+    report << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const LoadViewer::Stats& stats = results[i];
+        double mbps = stats.receiving_seconds > 0 ? stats.bytes * 8 / stats.receiving_seconds / 1000000.0 : 0;
+        double fps = stats.receiving_seconds > 0 ? stats.frames / stats.receiving_seconds / tracks : 0;
+        if (stats.join_ms >= 0) {
+            receiving++;
+            join_ms.push_back(stats.join_ms);
+            fps_per_viewer.push_back(static_cast<int64_t>(fps));
+        }
+        total_freezes += stats.freezes;
+        total_mbps += mbps;
+
+        report << "    {\"viewer\": " << stats.index << ", \"sessionId\": \"" << stats.session_id
+               << "\", \"connected\": " << (stats.connected ? "true" : "false")
+               << ", \"join_ms\": " << stats.join_ms << ", \"mbps\": " << mbps << ", \"fps\": " << fps
+               << ", \"frames\": " << stats.frames << ", \"freezes\": " << stats.freezes
+               << ", \"freeze_seconds\": " << stats.freeze_seconds
+               << ", \"error\": \"" << EscapeJson(stats.error) << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    report << "  ]\n";
+    report << "}\n";
+
+    std::cout << "\n========== LOAD GENERATOR RESULTS ==========\n";
+    std::cout << "Receiving: " << receiving << "/" << num_viewers << " viewers\n";
+    std::cout << "Join time p50/p95/max: " << Percentile(join_ms, 0.5) << "/" << Percentile(join_ms, 0.95) << "/"
+              << Percentile(join_ms, 1.0) << " ms\n";
+    std::cout << "FPS per track, slowest/median: " << Percentile(fps_per_viewer, 0.0) << "/"
+              << Percentile(fps_per_viewer, 0.5) << "\n";
+    std::cout << "Aggregate: " << total_mbps << " Mbps, " << total_freezes << " freezes\n";
+    std::cout << "Report written to " << report_path << "\n";
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
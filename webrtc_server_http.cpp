@@ -1,15 +1,29 @@
 // webrtc_server_http.cpp
-// C++ WebRTC server with simple HTTP signaling (no WebSocket needed!)
+// C++ WebRTC server with simple HTTP signaling and a native WebSocket endpoint
 
+#include "admission_control.h"
+#include "async_logger.h"
+#include "bitrate_profile.h"
+#include "capacity_sweep.h"
+#include "cpu_usage.h"
 #include "encoded_video_source.h"
+#include "factory_shard.h"
+#include "instrumented_task_queue.h"
+#include "keyframe_coordinator.h"
+#include "network_emulation.h"
 #include "peer_connection_handler.h"
-#include "simple_video_factories.h"
+#include "quality_controller.h"
+#include "signaling_json.h"
+#include "thread_placement.h"
+#include "websocket_server.h"
 
-#include <api/create_peerconnection_factory.h>
-#include <api/audio_codecs/builtin_audio_encoder_factory.h>
-#include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <rtc_base/event_tracer.h>
 #include <rtc_base/logging.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -18,7 +32,10 @@
 #include <sstream>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <map>
+#include <set>
+#include <vector>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -35,104 +52,238 @@ std::atomic<bool> g_running(true);
 std::shared_ptr<EncodedVideoSource> g_video_source;
 std::map<std::string, std::shared_ptr<PeerConnectionHandler>> g_peer_handlers;  // Support multiple clients
 std::mutex g_peers_mutex;
-rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> g_factory;
 
-// Threads
-std::unique_ptr<rtc::Thread> g_network_thread;
-std::unique_ptr<rtc::Thread> g_worker_thread;
-std::unique_ptr<rtc::Thread> g_signaling_thread;
+// Peer connection factories, one per shard (--shards=K)
+FactoryShardPool g_shards;
+std::map<std::string, FactoryShard*> g_session_shards;  // sessionId -> shard (guarded by g_peers_mutex)
+
+// Last measured bandwidth per clientId, seeds the next session's start bitrate
+BandwidthHistory g_bandwidth_history;
+std::map<std::string, std::string> g_session_clients;  // sessionId -> clientId (guarded by g_peers_mutex)
+
+// Per-viewer adaptive quality (null when disabled with --no-adapt)
+std::unique_ptr<AdaptiveQualityController> g_quality_controller;
+
+// Rejects offers beyond the CPU/egress/session budgets; rejected clients
+// are pointed at --redirect when set
+std::unique_ptr<AdmissionController> g_admission;
+std::string g_redirect_url;
+
+// CPU placement of named threads (--pin) and per-thread CPU telemetry
+ThreadPlacement g_thread_placement;
+ThreadCpuMonitor g_thread_cpu;
+
+// Data channel benchmark (--datachannel); --no-video leaves only the data channel
+bool g_dc_bench = false;
+DataChannelBenchConfig g_dc_config;
+bool g_send_video = true;
+
+// Sources of each session's 2nd..Nth video track (--tracks); may repeat
+// g_video_source when tracks share it
+std::vector<std::shared_ptr<EncodedVideoSource>> g_track_sources;
+
+// Record every session's outgoing video (--record)
+bool g_record_all = false;
+
+// Emulated network impairments on each session's egress (--netem); with
+// --netem-client an offer's "netem" field overrides them for its session
+NetworkEmulationConfig g_netem_config;
+bool g_netem_from_client = false;
+auto g_netem_counters = std::make_shared<NetworkEmulationCounters>();
+
+// What viewers get while their video is hidden ("visibility" messages;
+// --hidden=suspend|thumbnail|off)
+bool g_hidden_enabled = true;
+HiddenMode g_hidden_mode = HiddenMode::kSuspend;
+
+// Forced keyframes for re-shown viewers and recording starts, merged per
+// session and paced across sessions (--keyframes-per-second). Joins need
+// none: a new session's encoder starts with a keyframe.
+std::unique_ptr<KeyframeCoordinator> g_keyframes;
+KeyframeCoordinatorConfig g_keyframe_config;
+
+// Recent joins, offer -> connected and offer -> first frame shown (reported
+// by the client with "first-frame"), in ms (guarded by g_peers_mutex)
+struct JoinSample {
+    int64_t connect_ms;
+    int64_t first_frame_ms;
+};
+std::deque<JoinSample> g_join_samples;
+const size_t kMaxJoinSamples = 1000;
+
+// Sessions that failed, dropped or went silent are removed after these
+// grace periods (--reap-grace, --reap-idle; --no-reap disables)
+bool g_reap_enabled = true;
+int64_t g_reap_grace_ms = 10000;
+int64_t g_reap_idle_ms = 30000;
+std::map<std::string, uint64_t> g_reaped;  // reason -> sessions (guarded by g_peers_mutex)
+
+// Diagnostics written on request through POST /control
+std::string g_log_dir = ".";
+std::mutex g_trace_mutex;
+bool g_trace_active = false;
+std::chrono::steady_clock::time_point g_trace_deadline;
+
+// Open WebSocket signaling connections (closed on shutdown)
+std::set<std::shared_ptr<WebSocketConnection>> g_ws_connections;
+std::mutex g_ws_mutex;
+
+// One per WebSocket session, joined before shutdown tears down the sessions'
+// handlers and factories. Only the accept loop and shutdown touch the list;
+// finished sessions are joined on the next accept.
+struct WebSocketSessionThread {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+};
+std::vector<WebSocketSessionThread> g_ws_threads;
+
+// Command line flags: "--name=value" or "--name", accepted anywhere on the command line
+std::string GetFlag(int argc, char* argv[], const std::string& name, const std::string& fallback = "") {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.length(), prefix) == 0) {
+            return arg.substr(prefix.length());
+        }
+    }
+    return fallback;
+}
+
+bool HasFlag(int argc, char* argv[], const std::string& name) {
+    std::string flag = "--" + name;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == flag || arg.compare(0, flag.length() + 1, flag + "=") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
 void SignalHandler(int signal) {
     std::cout << "\nShutdown signal received..." << std::endl;
     g_running = false;
 }
 
-std::string ExtractJsonField(const std::string& json, const std::string& field) {
-    // Simple JSON parsing - look for "field":"value" or "field":value
-    std::string search = "\"" + field + "\"";
-    size_t pos = json.find(search);
-    if (pos == std::string::npos) return "";
-    
-    pos += search.length();
-    
-    // Skip whitespace and colon
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == ':')) pos++;
-    
-    if (pos >= json.length()) return "";
-    
-    // Check if it's a string (starts with quote)
-    if (json[pos] == '"') {
-        pos++; // Skip opening quote
-        size_t end = pos;
-        
-        // Find closing quote, handling escaped quotes
-        while (end < json.length()) {
-            if (json[end] == '"' && (end == pos || json[end-1] != '\\')) {
-                break;
-            }
-            end++;
+std::string g_pending_answer;  // Store answer to send back
+std::mutex g_answer_mutex;
+std::condition_variable g_answer_cv;  // Signal when answer is ready
+
+// Keeps client-supplied ids out of file paths
+std::string SanitizeFileName(const std::string& name) {
+    std::string safe;
+    for (char c : name) {
+        safe += (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') ? c : '_';
+    }
+    return safe;
+}
+
+std::string TimestampString() {
+    return std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Drops a session and everything held for it. Caller holds g_peers_mutex.
+// Returns the handler so the caller can destroy it (a synchronous
+// PeerConnection::Close) after unlocking.
+std::shared_ptr<PeerConnectionHandler> RemoveSessionLocked(const std::string& sessionId) {
+    auto it = g_peer_handlers.find(sessionId);
+    if (it == g_peer_handlers.end()) {
+        return nullptr;
+    }
+    g_bandwidth_history.Record(g_session_clients[sessionId],
+                               static_cast<int>(it->second->GetLatestStats().available_outgoing_bitrate_bps));
+    g_session_clients.erase(sessionId);
+    g_shards.Release(g_session_shards[sessionId]);
+    g_session_shards.erase(sessionId);
+    if (g_quality_controller) {
+        g_quality_controller->RemoveSession(sessionId);
+    }
+    if (g_admission) {
+        g_admission->RemoveSession(sessionId);
+    }
+    if (g_keyframes) {
+        g_keyframes->RemoveSession(sessionId);
+    }
+    std::shared_ptr<PeerConnectionHandler> handler = std::move(it->second);
+    g_peer_handlers.erase(it);
+    return handler;
+}
+
+// Removes sessions nobody will close: failed or disconnected for longer than
+// the grace period, never connected, or connected but silent (a live peer
+// sends RTCP every second). Caller holds g_peers_mutex; the removed
+// handlers go to released, to be destroyed after unlocking.
+void ReapSessionsLocked(std::vector<std::shared_ptr<PeerConnectionHandler>>* released) {
+    std::vector<std::pair<std::string, std::string>> reap;
+    for (auto& [id, handler] : g_peer_handlers) {
+        SessionState state = handler->GetState();
+        int64_t age_ms = handler->GetStateAgeMs();
+        const char* reason = nullptr;
+        if (state == SessionState::kClosed) {
+            reason = "closed";
+        } else if (state == SessionState::kFailed && age_ms >= g_reap_grace_ms) {
+            reason = "failed";
+        } else if (state == SessionState::kDisconnected && age_ms >= g_reap_grace_ms) {
+            reason = "disconnected";
+        } else if ((state == SessionState::kNew || state == SessionState::kConnecting) && age_ms >= g_reap_idle_ms) {
+            reason = "never connected";
+        } else if (state == SessionState::kConnected && handler->GetIdleMs() >= g_reap_idle_ms) {
+            reason = "idle";
         }
-        
-        if (end < json.length()) {
-            std::string result = json.substr(pos, end - pos);
-            
-            // Unescape common sequences
-            size_t escPos = 0;
-            while ((escPos = result.find("\\n", escPos)) != std::string::npos) {
-                result.replace(escPos, 2, "\n");
-                escPos++;
-            }
-            escPos = 0;
-            while ((escPos = result.find("\\r", escPos)) != std::string::npos) {
-                result.replace(escPos, 2, "\r");
-                escPos++;
-            }
-            escPos = 0;
-            while ((escPos = result.find("\\\"", escPos)) != std::string::npos) {
-                result.replace(escPos, 2, "\"");
-                escPos++;
-            }
-            escPos = 0;
-            while ((escPos = result.find("\\\\", escPos)) != std::string::npos) {
-                result.replace(escPos, 2, "\\");
-                escPos++;
-            }
-            
-            return result;
+        if (reason) {
+            reap.emplace_back(id, reason);
         }
     }
-    // Check if it's a number
-    else if (isdigit(json[pos]) || json[pos] == '-') {
-        size_t end = pos;
-        while (end < json.length() && (isdigit(json[end]) || json[end] == '.' || json[end] == '-')) {
-            end++;
-        }
-        return json.substr(pos, end - pos);
+    for (const auto& [id, reason] : reap) {
+        released->push_back(RemoveSessionLocked(id));
+        g_reaped[reason]++;
+        LogRecord(LogLevel::kInfo, "session-reaped").Session(id).Kv("reason", reason)
+            .Kv("remaining", g_peer_handlers.size());
     }
-    
-    return "";
 }
 
-std::string EscapeJson(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        if (c == '"') result += "\\\"";
-        else if (c == '\\') result += "\\\\";
-        else if (c == '\n') result += "\\n";
-        else if (c == '\r') result += "\\r";
-        else if (c == '\t') result += "\\t";
-        else result += c;
-    }
-    return result;
+// Forces a keyframe for one session, paced with everyone else's when the
+// keyframe coordinator is running
+// Admission estimate of a new session: the start bitrate and pixel rate of
+// every track it will send, each from its own source's resolution and fps
+SessionEstimate EstimateNewSession() {
+    SessionEstimate estimate;
+    if (!g_send_video) {
+        return estimate;
+    }
+    std::vector<EncodedVideoSource*> sources = {g_video_source.get()};
+    for (const auto& source : g_track_sources) {
+        sources.push_back(source.get());
+    }
+    for (EncodedVideoSource* source : sources) {
+        BitrateProfile profile = SelectBitrateProfile(source->GetWidth(), source->GetHeight(), source->GetFps());
+        estimate.start_bitrate_bps += profile.start_bitrate_bps;
+        estimate.pixels_per_second += static_cast<double>(source->GetWidth()) * source->GetHeight() * source->GetFps();
+    }
+    return estimate;
 }
 
-std::string g_pending_answer;  // Store answer to send back
-std::mutex g_answer_mutex;
-std::condition_variable g_answer_cv;  // Signal when answer is ready
+void RequestSessionKeyFrame(const std::string& sessionId, const std::shared_ptr<PeerConnectionHandler>& handler,
+                            const char* reason) {
+    if (g_keyframes) {
+        g_keyframes->Request(sessionId, handler, reason);
+    } else {
+        handler->RequestKeyFrame();
+    }
+}
 
-std::string HandleSignalingMessage(const std::string& body) {
-    std::string type = ExtractJsonField(body, "type");
-    std::string sessionId = ExtractJsonField(body, "sessionId");
+// Handles one signaling message.
+// HTTP requests get the answer as the return value. WebSocket sessions pass
+// their connection: the answer and server ICE candidates are pushed on it as
+// they become ready, and the session id is the one assigned at connect time.
+std::string HandleSignalingMessage(const std::string& body,
+                                   std::shared_ptr<WebSocketConnection> ws = nullptr,
+                                   const std::string& ws_session_id = "") {
+    // Tokenize once; fields are unescaped only when read
+    SignalingMessage parsed(body);
+    std::string type = parsed.GetString("type");
+    std::string sessionId = ws ? ws_session_id : parsed.GetString("sessionId");
     
     // Generate session ID if not provided
     if (sessionId.empty()) {
@@ -143,7 +294,7 @@ std::string HandleSignalingMessage(const std::string& body) {
     std::cout << "Body length: " << body.length() << " bytes" << std::endl;
     
     if (type == "offer") {
-        std::string sdp = ExtractJsonField(body, "sdp");
+        std::string sdp = parsed.GetString("sdp");
         std::cout << "Extracted SDP length: " << sdp.length() << " bytes" << std::endl;
         
         if (sdp.length() > 100) {
@@ -154,33 +305,128 @@ std::string HandleSignalingMessage(const std::string& body) {
             std::lock_guard<std::mutex> lock(g_peers_mutex);
             
             // Create peer handler for this client
-            if (g_peer_handlers.find(sessionId) == g_peer_handlers.end() && g_factory && g_video_source) {
+            if (g_peer_handlers.find(sessionId) == g_peer_handlers.end() && g_shards.size() > 0 && g_video_source) {
+                if (g_admission) {
+                    AdmissionDecision decision = g_admission->Admit(sessionId, EstimateNewSession());
+                    if (!decision.admitted) {
+                        LogRecord(LogLevel::kWarning, "session-rejected").Session(sessionId)
+                            .Kv("limit", decision.limit).Kv("reason", decision.reason);
+                        std::string error = "{\"type\":\"error\",\"code\":\"capacity\",\"limit\":\"" +
+                                            decision.limit + "\",\"message\":\"";
+                        AppendEscapedJson(&error, decision.reason);
+                        error += "\"";
+                        if (!g_redirect_url.empty()) {
+                            error += ",\"redirect\":\"";
+                            AppendEscapedJson(&error, g_redirect_url);
+                            error += "\"";
+                        }
+                        error += ",\"sessionId\":\"" + sessionId + "\"}";
+                        return error;
+                    }
+                }
+                
                 std::cout << "Creating peer connection handler for session " << sessionId << "..." << std::endl;
                 
-                auto callback = [sessionId](const std::string& msg_type, const std::string& message) {
-                    std::cout << "Session [" << sessionId << "] callback: " << msg_type << std::endl;
-                    
-                    // Store the answer to send back
-                    if (msg_type == "answer") {
-                        std::lock_guard<std::mutex> lock(g_answer_mutex);
-                        std::string escaped_sdp = EscapeJson(message);
-                        g_pending_answer = "{\"type\":\"answer\",\"sdp\":\"" + escaped_sdp + "\",\"sessionId\":\"" + sessionId + "\"}";
-                        std::cout << "Answer ready for session " << sessionId << std::endl;
-                        g_answer_cv.notify_all();  // Wake up waiting thread
-                    }
-                };
+                SignalingCallback callback;
+                if (ws) {
+                    // Push answer and trickled server candidates on the persistent connection
+                    // (SendText only queues: this runs on the shard's signaling thread)
+                    std::weak_ptr<WebSocketConnection> weak_ws = ws;
+                    callback = [sessionId, weak_ws](const std::string& msg_type, const std::string& message) {
+                        auto conn = weak_ws.lock();
+                        if (!conn) return;
+                        
+                        if (msg_type == "answer") {
+                            std::string answer = "{\"type\":\"answer\",\"sdp\":\"";
+                            AppendEscapedJson(&answer, message);
+                            answer += "\",\"sessionId\":\"" + sessionId + "\"}";
+                            conn->SendText(answer);
+                            LogRecord(LogLevel::kInfo, "answer-sent").Session(sessionId).Kv("transport", "websocket");
+                        } else if (msg_type == "ice-candidate") {
+                            conn->SendText(message);
+                        }
+                    };
+                } else {
+                    callback = [sessionId](const std::string& msg_type, const std::string& message) {
+                        LogRecord(LogLevel::kDebug, "signaling-callback").Session(sessionId).Kv("type", msg_type);
+                        
+                        // Store the answer to send back
+                        if (msg_type == "answer") {
+                            std::lock_guard<std::mutex> lock(g_answer_mutex);
+                            g_pending_answer = "{\"type\":\"answer\",\"sdp\":\"";
+                            AppendEscapedJson(&g_pending_answer, message);
+                            g_pending_answer += "\",\"sessionId\":\"" + sessionId + "\"}";
+                            LogRecord(LogLevel::kInfo, "answer-ready").Session(sessionId).Kv("transport", "http");
+                            g_answer_cv.notify_all();  // Wake up waiting thread
+                        }
+                    };
+                }
+                
+                FactoryShard* shard = g_shards.Acquire();
                 
-                g_peer_handlers[sessionId] = std::make_shared<PeerConnectionHandler>(
-                    g_factory,
-                    g_video_source,
-                    callback
+                // Each session gets its own emulated link
+                std::unique_ptr<rtc::PacketSocketFactory> socket_factory;
+                std::shared_ptr<const EmulatedLink> emulated_link;
+                NetworkEmulationConfig netem = g_netem_config;
+                std::string session_netem = g_netem_from_client ? parsed.GetString("netem") : "";
+                std::string netem_error;
+                if (!session_netem.empty() && !netem.Parse(session_netem, &netem_error)) {
+                    LogRecord(LogLevel::kWarning, "netem-ignored").Session(sessionId).Kv("spec", session_netem)
+                        .Kv("error", netem_error);
+                    netem = g_netem_config;
+                }
+                if (netem.enabled()) {
+                    LogRecord(LogLevel::kInfo, "netem").Session(sessionId).Kv("config", netem.ToString());
+                    auto emulated = std::make_unique<EmulatedPacketSocketFactory>(shard->network_thread(), netem,
+                                                                                  g_netem_counters);
+                    emulated_link = emulated->link();
+                    socket_factory = std::move(emulated);
+                }
+                
+                auto handler = std::make_shared<PeerConnectionHandler>(
+                    shard->factory(),
+                    g_send_video ? g_video_source : nullptr,
+                    callback,
+                    std::move(socket_factory)
                 );
+                handler->SetSessionId(sessionId);
+                handler->SetEmulatedLink(emulated_link);
+                if (g_send_video) {
+                    for (const auto& source : g_track_sources) {
+                        handler->AddVideoTrack(source);
+                    }
+                }
+                if (g_dc_bench) {
+                    handler->StartDataChannelBench(g_dc_config);
+                }
+                if (g_record_all) {
+                    handler->StartRecording(g_log_dir + "/recording_" + SanitizeFileName(sessionId) + "_" +
+                                            TimestampString() + ".ivf");
+                }
+                
+                // Fast start: pick the bitrate profile for the stream, seeded from
+                // this client's last measured bandwidth if it has been here before
+                std::string clientId = parsed.GetString("clientId");
+                BitrateProfile profile = SelectBitrateProfile(
+                    g_video_source->GetWidth(), g_video_source->GetHeight(), g_video_source->GetFps());
+                profile = SeedBitrateProfile(profile, g_bandwidth_history.Lookup(clientId));
+                handler->ApplyBitrateProfile(profile);
+                
+                g_peer_handlers[sessionId] = handler;
+                g_session_clients[sessionId] = clientId;
+                g_session_shards[sessionId] = shard;
                 
-                std::cout << "Peer connection handler created. Total clients: " << g_peer_handlers.size() << std::endl;
+                LogRecord(LogLevel::kInfo, "session-created").Session(sessionId).Kv("shard", shard->index())
+                    .Kv("sessions", g_peer_handlers.size());
             }
             
             // Handle the offer
             auto it = g_peer_handlers.find(sessionId);
+            if (it != g_peer_handlers.end() && ws) {
+                // Answer arrives asynchronously through the session callback
+                it->second->HandleOffer(sdp);
+                return "";
+            }
             if (it != g_peer_handlers.end()) {
                 std::cout << "Processing offer for session " << sessionId << "..." << std::endl;
                 
@@ -216,15 +462,9 @@ std::string HandleSignalingMessage(const std::string& body) {
         return "{\"type\":\"error\",\"message\":\"Failed to process offer\",\"sessionId\":\"" + sessionId + "\"}";
     }
     else if (type == "ice-candidate") {
-        std::string candidate = ExtractJsonField(body, "candidate");
-        std::string sdpMid = ExtractJsonField(body, "sdpMid");
-        
-        // Extract sdpMLineIndex
-        std::string mlineStr = ExtractJsonField(body, "sdpMLineIndex");
-        int sdpMLineIndex = 0;
-        if (!mlineStr.empty()) {
-            sdpMLineIndex = std::stoi(mlineStr);
-        }
+        std::string candidate = parsed.GetString("candidate");
+        std::string sdpMid = parsed.GetString("sdpMid");
+        int sdpMLineIndex = parsed.GetInt("sdpMLineIndex", 0);
         
         std::lock_guard<std::mutex> lock(g_peers_mutex);
         auto it = g_peer_handlers.find(sessionId);
@@ -233,14 +473,50 @@ std::string HandleSignalingMessage(const std::string& body) {
             it->second->HandleIceCandidate(candidate, sdpMid, sdpMLineIndex);
         }
         
+        if (ws) return "";
         return "{\"type\":\"ok\",\"sessionId\":\"" + sessionId + "\"}";
     }
-    else if (type == "close") {
+    else if (type == "visibility") {
+        // {"type":"visibility","visible":false} from the page's visibilitychange
+        bool visible = parsed.GetString("visible") != "false";
         std::lock_guard<std::mutex> lock(g_peers_mutex);
         auto it = g_peer_handlers.find(sessionId);
-        if (it != g_peer_handlers.end()) {
+        if (it != g_peer_handlers.end() && g_hidden_enabled) {
+            LogRecord(LogLevel::kInfo, "visibility").Session(sessionId).Kv("visible", visible ? "true" : "false");
+            it->second->SetVisible(visible, g_hidden_mode);
+            if (visible) {
+                RequestSessionKeyFrame(sessionId, it->second, "visible");
+            }
+        }
+        
+        if (ws) return "";
+        return "{\"type\":\"ok\",\"sessionId\":\"" + sessionId + "\"}";
+    }
+    else if (type == "first-frame") {
+        // {"type":"first-frame","ms":N}: time from the client's offer to its
+        // first decoded frame; only the first report of a session counts
+        int64_t first_frame_ms = parsed.GetInt("ms", -1);
+        std::lock_guard<std::mutex> lock(g_peers_mutex);
+        auto it = g_peer_handlers.find(sessionId);
+        if (it != g_peer_handlers.end() && first_frame_ms >= 0 && it->second->GetFirstFrameMs() < 0) {
+            it->second->SetFirstFrameMs(first_frame_ms);
+            LogRecord(LogLevel::kInfo, "first-frame").Session(sessionId).Kv("ms", first_frame_ms)
+                .Kv("connect_ms", it->second->GetConnectMs());
+            g_join_samples.push_back({it->second->GetConnectMs(), first_frame_ms});
+            if (g_join_samples.size() > kMaxJoinSamples) {
+                g_join_samples.pop_front();
+            }
+        }
+        
+        if (ws) return "";
+        return "{\"type\":\"ok\",\"sessionId\":\"" + sessionId + "\"}";
+    }
+    else if (type == "close") {
+        std::shared_ptr<PeerConnectionHandler> closed;  // Destroyed after the unlock
+        std::lock_guard<std::mutex> lock(g_peers_mutex);
+        if (g_peer_handlers.count(sessionId)) {
             std::cout << "Closing session " << sessionId << std::endl;
-            g_peer_handlers.erase(it);
+            closed = RemoveSessionLocked(sessionId);
             std::cout << "Session closed. Remaining clients: " << g_peer_handlers.size() << std::endl;
         }
         return "{\"type\":\"ok\",\"sessionId\":\"" + sessionId + "\"}";
@@ -250,6 +526,139 @@ std::string HandleSignalingMessage(const std::string& body) {
     return "{\"type\":\"error\",\"message\":\"Unknown message type\",\"sessionId\":\"" + sessionId + "\"}";
 }
 
+void StopTraceCapture() {
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    if (g_trace_active) {
+        rtc::tracing::StopInternalCapture();
+        g_trace_active = false;
+        LogRecord(LogLevel::kInfo, "trace-stopped");
+    }
+}
+
+// Diagnostics control, e.g.
+//   {"action":"start-event-log","sessionId":"..."}  -> RtcEventLog of one session
+//   {"action":"stop-event-log","sessionId":"..."}
+//   {"action":"start-recording","sessionId":"..."}  -> IVF of the video sent to one session
+//   {"action":"stop-recording","sessionId":"..."}
+//   {"action":"start-trace","seconds":10}           -> Chrome trace of the whole process
+//   {"action":"stop-trace"}
+// Output files are named by the server and written to --log-dir.
+std::string HandleControlMessage(const std::string& body) {
+    SignalingMessage parsed(body);
+    std::string action = parsed.GetString("action");
+    std::string sessionId = parsed.GetString("sessionId");
+    
+    if (action == "start-recording" || action == "stop-recording") {
+        std::lock_guard<std::mutex> lock(g_peers_mutex);
+        auto it = g_peer_handlers.find(sessionId);
+        if (it == g_peer_handlers.end()) {
+            return "{\"type\":\"error\",\"message\":\"Unknown session\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        if (action == "stop-recording") {
+            it->second->StopRecording();
+            return "{\"type\":\"ok\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        
+        std::string path = g_log_dir + "/recording_" + SanitizeFileName(sessionId) + "_" + TimestampString() + ".ivf";
+        if (!it->second->StartRecording(path)) {
+            return "{\"type\":\"error\",\"message\":\"Failed to start recording\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        // The recorder skips everything up to a keyframe; don't wait for the periodic one
+        RequestSessionKeyFrame(sessionId, it->second, "recording");
+        return "{\"type\":\"ok\",\"file\":\"" + EscapeJson(path) + "\"}";
+    }
+    
+    if (action == "start-event-log" || action == "stop-event-log") {
+        std::lock_guard<std::mutex> lock(g_peers_mutex);
+        auto it = g_peer_handlers.find(sessionId);
+        if (it == g_peer_handlers.end()) {
+            return "{\"type\":\"error\",\"message\":\"Unknown session\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        if (action == "stop-event-log") {
+            it->second->StopEventLog();
+            return "{\"type\":\"ok\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        
+        std::string path = g_log_dir + "/rtc_event_" + SanitizeFileName(sessionId) + "_" + TimestampString() + ".log";
+        if (!it->second->StartEventLog(path)) {
+            return "{\"type\":\"error\",\"message\":\"Failed to start event log\",\"sessionId\":\"" + EscapeJson(sessionId) + "\"}";
+        }
+        return "{\"type\":\"ok\",\"file\":\"" + EscapeJson(path) + "\"}";
+    }
+    
+    if (action == "start-trace") {
+        int seconds = parsed.GetInt("seconds", 10);
+        std::string path = g_log_dir + "/trace_" + TimestampString() + ".json";
+        
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        if (g_trace_active) {
+            return "{\"type\":\"error\",\"message\":\"Trace already running\"}";
+        }
+        if (!rtc::tracing::StartInternalCapture(path)) {
+            return "{\"type\":\"error\",\"message\":\"Failed to start trace\"}";
+        }
+        g_trace_active = true;
+        g_trace_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(std::max(1, seconds));
+        LogRecord(LogLevel::kInfo, "trace-started").Kv("seconds", seconds).Kv("path", path);
+        return "{\"type\":\"ok\",\"file\":\"" + EscapeJson(path) + "\"}";
+    }
+    
+    if (action == "stop-trace") {
+        StopTraceCapture();
+        return "{\"type\":\"ok\"}";
+    }
+    
+    return "{\"type\":\"error\",\"message\":\"Unknown action\"}";
+}
+
+// Serves one browser over a persistent WebSocket until it disconnects.
+// Mirrors signaling-relay.js: the session id is assigned on connect and the
+// session is closed when the socket goes away.
+void RunWebSocketSession(std::shared_ptr<WebSocketConnection> ws, std::shared_ptr<std::atomic<bool>> done) {
+    std::string sessionId = "ws-" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    LogRecord(LogLevel::kInfo, "websocket-connected").Session(sessionId);
+    
+    std::string message;
+    while (g_running && ws->ReadMessage(&message)) {
+        std::string result = HandleSignalingMessage(message, ws, sessionId);
+        if (!result.empty()) {
+            ws->SendText(result);
+        }
+    }
+    
+    LogRecord(LogLevel::kInfo, "websocket-disconnected").Session(sessionId);
+    HandleSignalingMessage("{\"type\":\"close\"}", ws, sessionId);
+    
+    {
+        std::lock_guard<std::mutex> lock(g_ws_mutex);
+        g_ws_connections.erase(ws);
+    }
+    *done = true;
+}
+
+void JoinFinishedWebSocketSessions() {
+    auto finished = std::partition(g_ws_threads.begin(), g_ws_threads.end(),
+                                   [](const WebSocketSessionThread& session) { return !*session.done; });
+    for (auto it = finished; it != g_ws_threads.end(); ++it) {
+        it->thread.join();
+    }
+    g_ws_threads.erase(finished, g_ws_threads.end());
+}
+
+// Closes every WebSocket and waits for the sessions to close their peers
+void StopWebSocketSessions() {
+    {
+        std::lock_guard<std::mutex> lock(g_ws_mutex);
+        for (auto& ws : g_ws_connections) {
+            ws->Close();
+        }
+    }
+    for (WebSocketSessionThread& session : g_ws_threads) {
+        session.thread.join();
+    }
+    g_ws_threads.clear();
+}
+
 void RunHTTPServer(int port) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
@@ -303,25 +712,60 @@ void RunHTTPServer(int port) {
             continue;
         }
         
-        // Read HTTP request
+        // Read HTTP request: headers, then the body up to its Content-Length
+        // (offers with several m-sections do not fit in one read)
+        std::string request;
         char buffer[8192];
+        while (true) {
 #ifdef _WIN32
-        int bytes_read = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
+            int bytes_read = recv(client_fd, buffer, sizeof(buffer), 0);
 #else
-        ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
+            ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer));
 #endif
+            if (bytes_read <= 0) break;
+            request.append(buffer, bytes_read);
+            
+            size_t header_end = request.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                if (request.size() > 64 * 1024) break;
+                continue;
+            }
+            size_t content_length = 0;
+            std::string headers = request.substr(0, header_end);
+            std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+            size_t length_pos = headers.find("content-length:");
+            if (length_pos != std::string::npos) {
+                content_length = std::strtoul(headers.c_str() + length_pos + 15, nullptr, 10);
+            }
+            if (request.size() >= header_end + 4 + std::min<size_t>(content_length, 1024 * 1024)) break;
+        }
         
-        if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            std::string request(buffer);
+        if (!request.empty()) {
             
             // Extract body from POST request
             size_t body_pos = request.find("\r\n\r\n");
             std::string response;
             
-            if (body_pos != std::string::npos && request.find("POST /signaling") == 0) {
+            if (request.find("GET /signaling") == 0 && IsWebSocketUpgradeRequest(request)) {
+                // Hand the socket to a dedicated session thread; it owns the fd from here
+                auto ws = std::make_shared<WebSocketConnection>(client_fd);
+                if (ws->Accept(request)) {
+                    {
+                        std::lock_guard<std::mutex> lock(g_ws_mutex);
+                        g_ws_connections.insert(ws);
+                    }
+                    JoinFinishedWebSocketSessions();
+                    auto done = std::make_shared<std::atomic<bool>>(false);
+                    g_ws_threads.push_back({std::thread(RunWebSocketSession, ws, done), done});
+                }
+                continue;
+            }
+            
+            bool is_signaling = request.find("POST /signaling") == 0;
+            bool is_control = request.find("POST /control") == 0;
+            if (body_pos != std::string::npos && (is_signaling || is_control)) {
                 std::string body = request.substr(body_pos + 4);
-                std::string result = HandleSignalingMessage(body);
+                std::string result = is_control ? HandleControlMessage(body) : HandleSignalingMessage(body);
                 
                 std::ostringstream oss;
                 oss << "HTTP/1.1 200 OK\r\n";
@@ -374,26 +818,198 @@ int main(int argc, char* argv[]) {
     const int HTTP_PORT = 9090;
     
     // Parse command line arguments
-    // Usage: webrtc_server.exe [width] [height] [fps]
+    // Usage: webrtc_server.exe [width] [height] [fps] [--flags]
     // Example: webrtc_server.exe 1920 1080 30
-    // Example: webrtc_server.exe 3840 2160 60
-    if (argc >= 4) {
-        WIDTH = std::atoi(argv[1]);
-        HEIGHT = std::atoi(argv[2]);
-        FPS = std::atoi(argv[3]);
-    } else if (argc >= 2) {
-        std::cout << "Usage: " << argv[0] << " [width] [height] [fps]\n";
+    // Example: webrtc_server.exe 3840 2160 60 --no-adapt
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]).compare(0, 2, "--") != 0) {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() >= 3) {
+        WIDTH = std::atoi(positional[0].c_str());
+        HEIGHT = std::atoi(positional[1].c_str());
+        FPS = std::atoi(positional[2].c_str());
+    } else if (!positional.empty()) {
+        std::cout << "Usage: " << argv[0] << " [width] [height] [fps] [--flags]\n";
         std::cout << "Example: " << argv[0] << " 1920 1080 30\n";
         std::cout << "Example: " << argv[0] << " 3840 2160 60\n";
+        std::cout << "Flags:\n";
+        std::cout << "  --shards=K          Spread sessions over K peer connection factories (default 1)\n";
+        std::cout << "  --video-only        No audio device, audio processing or audio codecs\n";
+        std::cout << "  --static-content    Screen-share style stream: skip encoding unchanged frames\n";
+        std::cout << "  --delivery-queue[=N]  Deliver frames to each viewer from its own thread, N frames deep (default 3)\n";
+        std::cout << "  --delivery-policy=P   When a viewer's queue is full: drop-oldest (default) or keep-latest (same as a 1-deep queue)\n";
+        std::cout << "  --no-adapt          Disable per-viewer adaptive quality\n";
+        std::cout << "  --log-dir=DIR       Where recordings, event logs and traces are written (default .)\n";
+        std::cout << "  --log-file=FILE     Append session event records (key=value lines) to FILE instead of stdout\n";
+        std::cout << "  --log-level=LEVEL   debug, info (default), warning or error\n";
+        std::cout << "  --log-rate=N        Keep at most N debug/info records per second (default 1000, 0 = all)\n";
+        std::cout << "  --record            Record the video sent to every viewer to IVF (no re-encoding)\n";
+        std::cout << "  --datachannel[=N]   Stream N-byte data channel messages to ?datachannel=1 clients (default 65536)\n";
+        std::cout << "  --dc-unordered      Unordered delivery for the data channel benchmark\n";
+        std::cout << "  --dc-max-retransmits=N  Partial reliability for the data channel benchmark\n";
+        std::cout << "  --no-video          Do not send video (data channel or ingest only)\n";
+        std::cout << "  --tracks=N          Send N video tracks per session on one transport (clients use ?tracks=N)\n";
+        std::cout << "  --track-sources=LIST  Own sources for tracks 2.., e.g. 1280x720@30,640x360@15 (others share the main one)\n";
+        std::cout << "  --ingest=MODE       Receive video from ?ingest=1 clients: decode (default) or count (no decoding)\n";
+        std::cout << "  --pin=SPEC          Pin thread classes to CPUs, e.g. \"network=0-3;worker=4-7;encoder=node1\"\n";
+        std::cout << "  --netem=SPEC        Impair each session's egress, e.g. delay=50,jitter=10,loss=2,reorder=1,rate=2000,queue=300,seed=7\n";
+        std::cout << "  --netem-client      Let an offer's \"netem\" field set its own session's impairments\n";
+        std::cout << "  --admit-cpu=F       Reject offers that would push process CPU past F of all cores (default 0.9, 0 = off)\n";
+        std::cout << "  --admit-egress-mbps=N  Reject offers that would push total egress past N Mbps\n";
+        std::cout << "  --admit-encode-cost=C  CPU cores per megapixel/s a session is assumed to cost until one is measured (default 0.015)\n";
+        std::cout << "  --max-sessions=N    Reject offers beyond N live sessions\n";
+        std::cout << "  --redirect=URL      Sent with capacity errors so clients can retry on another server\n";
+        std::cout << "  --hidden=MODE       Viewers with hidden video: suspend (default), thumbnail or off\n";
+        std::cout << "  --keyframes-per-second=N  Pace forced keyframes (re-shown viewers, recording starts) to N per second (default 10)\n";
+        std::cout << "  --reap-grace=S      Remove failed/disconnected sessions after S seconds (default 10)\n";
+        std::cout << "  --reap-idle=S       Remove sessions that never connect or go silent for S seconds (default 30)\n";
+        std::cout << "  --no-reap           Keep sessions until the client sends \"close\"\n";
+        std::cout << "  --sweep             Run a capacity sweep with in-process viewers, write a JSON report and exit (not with --static-content)\n";
+        std::cout << "  --sweep-resolutions=LIST  e.g. 1280x720,1920x1080 (default 720p, 1080p, 4K)\n";
+        std::cout << "  --sweep-fps=LIST    e.g. 30,60 (default)\n";
+        std::cout << "  --sweep-codecs=LIST VP8,VP9 (default)\n";
+        std::cout << "  --sweep-viewers=LIST  Viewer counts to ramp through (default 1,2,4,8,16,32)\n";
+        std::cout << "  --sweep-seconds=N   Measurement window per step (default 10)\n";
+        std::cout << "  --sweep-report=FILE Report path (default sweep_report.json in --log-dir)\n";
         std::cout << "Using defaults...\n\n";
     }
+    int NUM_SHARDS = std::max(1, std::atoi(GetFlag(argc, argv, "shards", "1").c_str()));
+    g_log_dir = GetFlag(argc, argv, "log-dir", ".");
+    AsyncLoggerConfig logger_config;
+    logger_config.path = GetFlag(argc, argv, "log-file");
+    logger_config.max_records_per_second = std::atoi(GetFlag(argc, argv, "log-rate", "1000").c_str());
+    std::string log_level = GetFlag(argc, argv, "log-level", "info");
+    if (log_level == "debug") {
+        logger_config.min_level = LogLevel::kDebug;
+    } else if (log_level == "warning") {
+        logger_config.min_level = LogLevel::kWarning;
+    } else if (log_level == "error") {
+        logger_config.min_level = LogLevel::kError;
+    } else if (log_level != "info") {
+        std::cerr << "Invalid --log-level: " << log_level << " (expected debug, info, warning or error)" << std::endl;
+        return 1;
+    }
+    if (!AsyncLogger::Instance().Start(logger_config)) {
+        std::cerr << "Cannot open log file " << logger_config.path << std::endl;
+        return 1;
+    }
+    g_record_all = HasFlag(argc, argv, "record");
+    g_dc_bench = HasFlag(argc, argv, "datachannel");
+    g_dc_config.message_size = std::atoi(GetFlag(argc, argv, "datachannel", "65536").c_str());
+    g_dc_config.ordered = !HasFlag(argc, argv, "dc-unordered");
+    g_dc_config.max_retransmits = std::atoi(GetFlag(argc, argv, "dc-max-retransmits", "-1").c_str());
+    g_send_video = !HasFlag(argc, argv, "no-video");
+    std::string netem_error;
+    if (!g_netem_config.Parse(GetFlag(argc, argv, "netem"), &netem_error)) {
+        std::cerr << "Invalid --netem: " << netem_error << std::endl;
+        return 1;
+    }
+    g_netem_from_client = HasFlag(argc, argv, "netem-client");
+    AdmissionConfig admission_config;
+    admission_config.max_cpu = std::atof(GetFlag(argc, argv, "admit-cpu", "0.9").c_str());
+    admission_config.max_egress_mbps = std::atof(GetFlag(argc, argv, "admit-egress-mbps", "0").c_str());
+    admission_config.max_sessions = std::atoi(GetFlag(argc, argv, "max-sessions", "0").c_str());
+    admission_config.prior_cores_per_mpixel_s = std::atof(GetFlag(argc, argv, "admit-encode-cost", "0.015").c_str());
+    g_redirect_url = GetFlag(argc, argv, "redirect");
+    std::string hidden_mode = GetFlag(argc, argv, "hidden", "suspend");
+    if (hidden_mode == "thumbnail") {
+        g_hidden_mode = HiddenMode::kThumbnail;
+    } else if (hidden_mode == "off") {
+        g_hidden_enabled = false;
+    } else if (hidden_mode != "suspend") {
+        std::cerr << "Invalid --hidden: " << hidden_mode << " (expected suspend, thumbnail or off)" << std::endl;
+        return 1;
+    }
+    g_keyframe_config.max_per_second = std::max(1, std::atoi(GetFlag(argc, argv, "keyframes-per-second", "10").c_str()));
+    g_reap_enabled = !HasFlag(argc, argv, "no-reap");
+    g_reap_grace_ms = std::max(1, std::atoi(GetFlag(argc, argv, "reap-grace", "10").c_str())) * 1000LL;
+    g_reap_idle_ms = std::max(1, std::atoi(GetFlag(argc, argv, "reap-idle", "30").c_str())) * 1000LL;
+    std::string INGEST_MODE = GetFlag(argc, argv, "ingest", HasFlag(argc, argv, "ingest") ? "decode" : "");
+    if (!INGEST_MODE.empty() && INGEST_MODE != "decode" && INGEST_MODE != "count") {
+        std::cerr << "Invalid --ingest mode: " << INGEST_MODE << " (expected decode or count)" << std::endl;
+        return 1;
+    }
+    
+    FactoryOptions factory_options;
+    factory_options.video_only = HasFlag(argc, argv, "video-only");
+    factory_options.decode_video = INGEST_MODE != "count";
+    factory_options.skip_unchanged_frames = HasFlag(argc, argv, "static-content");
+    DeliveryQueueConfig delivery_config;
+    delivery_config.enabled = HasFlag(argc, argv, "delivery-queue");
+    delivery_config.depth = std::max(1, std::atoi(GetFlag(argc, argv, "delivery-queue", "3").c_str()));
+    std::string delivery_policy = GetFlag(argc, argv, "delivery-policy", "drop-oldest");
+    if (delivery_policy == "keep-latest") {
+        delivery_config.depth = 1;  // A one-frame queue only ever holds the newest frame
+    } else if (delivery_policy != "drop-oldest") {
+        std::cerr << "Invalid --delivery-policy: " << delivery_policy << " (expected drop-oldest or keep-latest)" << std::endl;
+        return 1;
+    }
+    int NUM_TRACKS = std::max(1, std::atoi(GetFlag(argc, argv, "tracks", "1").c_str()));
+    struct TrackSourceSpec {
+        int width;
+        int height;
+        int fps;
+    };
+    std::vector<TrackSourceSpec> track_source_specs;
+    {
+        std::stringstream list(GetFlag(argc, argv, "track-sources"));
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            if (item.empty()) continue;
+            TrackSourceSpec spec = {0, 0, 0};
+            if (std::sscanf(item.c_str(), "%dx%d@%d", &spec.width, &spec.height, &spec.fps) != 3 ||
+                spec.width <= 0 || spec.height <= 0 || spec.fps <= 0) {
+                std::cerr << "Invalid --track-sources entry: " << item << " (expected WIDTHxHEIGHT@FPS)" << std::endl;
+                return 1;
+            }
+            track_source_specs.push_back(spec);
+        }
+    }
+    
+    bool SWEEP_MODE = HasFlag(argc, argv, "sweep");
+    CapacitySweepConfig sweep_config;
+    std::string sweep_error;
+    if (!sweep_config.Parse(GetFlag(argc, argv, "sweep-resolutions"), GetFlag(argc, argv, "sweep-fps"),
+                            GetFlag(argc, argv, "sweep-codecs"), GetFlag(argc, argv, "sweep-viewers"),
+                            &sweep_error)) {
+        std::cerr << "Invalid sweep option: " << sweep_error << std::endl;
+        return 1;
+    }
+    if (SWEEP_MODE && factory_options.skip_unchanged_frames) {
+        // Unchanged frames aren't encoded, so every step would miss its fps target
+        std::cerr << "--sweep judges each step by the encoded frame rate; it can't run with --static-content" << std::endl;
+        return 1;
+    }
+    sweep_config.measure_seconds = std::max(1, std::atoi(GetFlag(argc, argv, "sweep-seconds", "10").c_str()));
+    sweep_config.report_path = GetFlag(argc, argv, "sweep-report", g_log_dir + "/sweep_report.json");
+    std::string pin_error;
+    if (!g_thread_placement.Parse(GetFlag(argc, argv, "pin"), &pin_error)) {
+        std::cerr << "Invalid --pin: " << pin_error << std::endl;
+        return 1;
+    }
     
     std::cout << "========================================\n";
     std::cout << "WebRTC C++ Server with libwebrtc + STUN\n";
     std::cout << "========================================\n";
     std::cout << "Video: " << WIDTH << "x" << HEIGHT << " @ " << FPS << " FPS\n";
-    std::cout << "HTTP Port: " << HTTP_PORT << "\n";
+    std::cout << "HTTP Port: " << HTTP_PORT << " (WebSocket: ws://<host>:" << HTTP_PORT << "/signaling)\n";
     std::cout << "STUN Server: stun.l.google.com:19302\n";
+    std::cout << "Factory Shards: " << NUM_SHARDS << "\n";
+    if (!INGEST_MODE.empty()) {
+        std::cout << "Ingest: " << (INGEST_MODE == "count" ? "count only (no decoding)" : "decode") << "\n";
+    }
+    if (delivery_config.enabled) {
+        std::cout << "Frame Delivery: per-viewer queue, " << delivery_config.depth << " deep, " << delivery_policy << "\n";
+    }
+    if (NUM_TRACKS > 1) {
+        std::cout << "Video Tracks Per Session: " << NUM_TRACKS << "\n";
+    }
+    if (!g_thread_placement.empty()) {
+        std::cout << "Thread Placement: " << g_thread_placement.Describe() << "\n";
+    }
     std::cout << "========================================\n\n";
 
 #ifdef _WIN32
@@ -407,67 +1023,311 @@ int main(int argc, char* argv[]) {
     signal(SIGINT, SignalHandler);
     signal(SIGTERM, SignalHandler);
 
+    // Trace events cost one flag check each until a capture is started
+    rtc::tracing::SetupInternalTracer();
+    
     try {
-        // Initialize WebRTC threads
-        g_network_thread = rtc::Thread::CreateWithSocketServer();
-        g_network_thread->SetName("network", nullptr);
-        g_network_thread->Start();
-        
-        g_worker_thread = rtc::Thread::Create();
-        g_worker_thread->SetName("worker", nullptr);
-        g_worker_thread->Start();
-        
-        g_signaling_thread = rtc::Thread::Create();
-        g_signaling_thread->SetName("signaling", nullptr);
-        g_signaling_thread->Start();
-        
-        std::cout << "WebRTC threads initialized\n";
-        
-        // Create peer connection factory with simple custom factories
-        g_factory = webrtc::CreatePeerConnectionFactory(
-            g_network_thread.get(),
-            g_worker_thread.get(),
-            g_signaling_thread.get(),
-            nullptr,
-            webrtc::CreateBuiltinAudioEncoderFactory(),
-            webrtc::CreateBuiltinAudioDecoderFactory(),
-            std::make_unique<webrtc::SimpleVideoEncoderFactory>(),
-            std::make_unique<webrtc::SimpleVideoDecoderFactory>(),
-            nullptr,
-            nullptr);
-        
-        if (!g_factory) {
+        // Initialize WebRTC threads and peer connection factories
+        // Each shard gets its own network/worker/signaling threads
+        if (!g_shards.Start(NUM_SHARDS, factory_options)) {
             std::cerr << "Failed to create peer connection factory" << std::endl;
             return 1;
         }
         
-        std::cout << "Peer connection factory created\n";
+        std::cout << "Peer connection factories created (" << NUM_SHARDS << " shard"
+                  << (NUM_SHARDS > 1 ? "s" : "") << ")\n";
+        
+        if (SWEEP_MODE) {
+            // Same sources and factories as live viewers get, no HTTP server
+            CapacitySweep sweep(sweep_config, &g_shards, [&](int width, int height, int fps) {
+                auto source = std::make_shared<EncodedVideoSource>(width, height, fps, 30);
+                source->SetDeliveryQueue(delivery_config);
+                return source;
+            });
+            bool ok = sweep.Run(g_running);
+            g_shards.Stop();
+            rtc::tracing::ShutdownInternalTracer();
+#ifdef _WIN32
+            WSACleanup();
+#endif
+            return ok ? 0 : 1;
+        }
+        
+        // Baseline for the idle CPU of the factories, reported before the first client
+        auto idle_cpu = std::make_shared<ProcessCpuMeter>();
         
         // Create encoded video source (reuses same frame data - MUCH more efficient!)
         g_video_source = std::make_shared<EncodedVideoSource>(WIDTH, HEIGHT, FPS, 30);  // GOP size = 30
+        g_video_source->SetScreencast(factory_options.skip_unchanged_frames);
+        g_video_source->SetDeliveryQueue(delivery_config);
         g_video_source->Start();
+        for (int track = 1; track < NUM_TRACKS; track++) {
+            if (track - 1 >= static_cast<int>(track_source_specs.size())) {
+                g_track_sources.push_back(g_video_source);
+                continue;
+            }
+            const TrackSourceSpec& spec = track_source_specs[track - 1];
+            auto source = std::make_shared<EncodedVideoSource>(spec.width, spec.height, spec.fps, 30);
+            source->SetScreencast(factory_options.skip_unchanged_frames);
+            source->SetDeliveryQueue(delivery_config);
+            source->Start();
+            g_track_sources.push_back(source);
+            std::cout << "Track " << track + 1 << " source: " << spec.width << "x" << spec.height
+                      << " @ " << spec.fps << " FPS\n";
+        }
         std::cout << "Encoded video source started (ZERO-COPY MODE)\n";
         std::cout << "Using same frame buffer repeatedly - encoder optimized\n\n";
         
+        if (!HasFlag(argc, argv, "no-adapt")) {
+            g_quality_controller = std::make_unique<AdaptiveQualityController>();
+            std::cout << "Adaptive quality controller enabled\n";
+        }
+        if (admission_config.max_cpu > 0 || admission_config.max_egress_mbps > 0 || admission_config.max_sessions > 0) {
+            g_admission = std::make_unique<AdmissionController>(admission_config);
+            std::cout << "Admission control enabled\n";
+        }
+        g_keyframes = std::make_unique<KeyframeCoordinator>(g_keyframe_config);
+        std::cout << "Forced keyframes paced to " << g_keyframe_config.max_per_second << "/s\n";
+        
         std::cout << "Server running!\n";
         std::cout << "Waiting for browser connections on port " << HTTP_PORT << "...\n\n";
         std::cout << "Press Ctrl+C to stop...\n\n";
         
         // Start stats reporting thread
+        // Polls per-session stats every second and prints a summary every 5 seconds
         std::thread stats_thread([&]() {
+            int tick = 0;
             while (g_running) {
-                std::this_thread::sleep_for(std::chrono::seconds(5));
+                std::this_thread::sleep_for(std::chrono::seconds(1));
                 
+                // Encoder threads appear with each new session
+                g_thread_placement.Apply();
+                
+                // End a timed trace capture
+                bool trace_expired;
+                {
+                    std::lock_guard<std::mutex> lock(g_trace_mutex);
+                    trace_expired = g_trace_active && std::chrono::steady_clock::now() >= g_trace_deadline;
+                }
+                if (trace_expired) {
+                    StopTraceCapture();
+                }
+                
+                // Declared before the lock so reaped handlers are destroyed
+                // (closing their peer connections) after it is released
+                std::vector<std::shared_ptr<PeerConnectionHandler>> reaped;
                 std::lock_guard<std::mutex> lock(g_peers_mutex);
+                for (auto& [id, handler] : g_peer_handlers) {
+                    handler->PollStats();
+                }
+                if (g_reap_enabled) {
+                    ReapSessionsLocked(&reaped);
+                }
+                if (g_admission) {
+                    g_admission->Tick(g_peer_handlers);
+                }
+                if (g_quality_controller) {
+                    g_quality_controller->Tick(g_peer_handlers);
+                }
+                
+                if (++tick % 5 != 0) {
+                    continue;
+                }
+                if (idle_cpu) {
+                    if (g_peer_handlers.empty()) {
+                        std::cout << "Idle CPU with " << g_shards.size() << " factor"
+                                  << (g_shards.size() > 1 ? "ies" : "y") << " and the frame source: "
+                                  << idle_cpu->SampleCores() << " cores, RSS "
+                                  << GetProcessRssBytes() / (1024 * 1024) << " MB\n";
+                    }
+                    idle_cpu.reset();
+                }
                 if (!g_peer_handlers.empty()) {
                     std::cout << "\n========== SERVER STATS ==========\n";
                     std::cout << "Active Clients: " << g_peer_handlers.size() << "\n";
                     std::cout << "Video Source: " << WIDTH << "x" << HEIGHT << " @ " << FPS << " FPS\n";
                     std::cout << "Frames Generated: " << g_video_source->GetFramesSent() << "\n";
+                    std::cout << "Downscales: " << PyramidFrameBuffer::ScalesComputed() << " computed for "
+                              << PyramidFrameBuffer::ScaleRequests() << " requests\n";
+                    std::vector<DeliveryQueueStats> delivery = g_video_source->GetDeliveryStats();
+                    if (!delivery.empty()) {
+                        std::cout << "Frame Delivery Drops (per sink):";
+                        for (const DeliveryQueueStats& queue : delivery) {
+                            std::cout << " " << queue.frames_dropped << "/" << queue.frames_queued;
+                        }
+                        std::cout << "\n";
+                    }
+                    if (g_netem_counters->packets > 0) {
+                        std::cout << "Network Emulation: " << g_netem_counters->packets << " packets, "
+                                  << g_netem_counters->lost << " lost, " << g_netem_counters->queue_drops
+                                  << " queue drops, " << g_netem_counters->reordered << " reordered\n";
+                    }
+                    // Per-session accounting: estimates that should add up to
+                    // roughly the RSS growth, so leaked sessions stand out
+                    size_t session_memory = 0;
+                    double encode_cores = 0;
+                    for (auto& [id, handler] : g_peer_handlers) {
+                        session_memory += handler->EstimateMemoryBytes();
+                        encode_cores += handler->GetLatestStats().encode_cpu_cores;
+                    }
+                    std::cout << "Session Resources: ~" << session_memory / (1024 * 1024) << " MB, encode "
+                              << encode_cores << " cores, process RSS " << GetProcessRssBytes() / (1024 * 1024)
+                              << " MB\n";
+                    int hidden_sessions = 0;
+                    int suspended_encoders = 0;
+                    for (auto& [id, handler] : g_peer_handlers) {
+                        if (!handler->IsHidden()) continue;
+                        hidden_sessions++;
+                        if (g_hidden_mode == HiddenMode::kSuspend) {
+                            suspended_encoders += handler->GetTrackCount();
+                        }
+                    }
+                    if (hidden_sessions > 0) {
+                        std::cout << "Hidden Viewers: " << hidden_sessions << ", encoders suspended: "
+                                  << suspended_encoders << "\n";
+                    }
+                    if (g_admission) {
+                        std::cout << "Admission: ~" << g_admission->marginal_cpu() * 100 << "% CPU and ~"
+                                  << g_admission->marginal_egress_bps() / 1000000.0 << " Mbps per session";
+                        for (const auto& [limit, count] : g_admission->rejected()) {
+                            std::cout << ", rejected " << count << " (" << limit << ")";
+                        }
+                        std::cout << "\n";
+                    }
+                    if (!g_join_samples.empty()) {
+                        std::vector<int64_t> connect_ms;
+                        std::vector<int64_t> first_frame_ms;
+                        for (const JoinSample& sample : g_join_samples) {
+                            if (sample.connect_ms >= 0) connect_ms.push_back(sample.connect_ms);
+                            first_frame_ms.push_back(sample.first_frame_ms);
+                        }
+                        std::sort(connect_ms.begin(), connect_ms.end());
+                        std::sort(first_frame_ms.begin(), first_frame_ms.end());
+                        auto at = [](const std::vector<int64_t>& sorted, double fraction) {
+                            return sorted.empty() ? -1 : sorted[static_cast<size_t>(fraction * (sorted.size() - 1))];
+                        };
+                        std::cout << "Joins (last " << g_join_samples.size() << "): connect p50 " << at(connect_ms, 0.5)
+                                  << " / p95 " << at(connect_ms, 0.95) << " ms, first frame p50 "
+                                  << at(first_frame_ms, 0.5) << " / p95 " << at(first_frame_ms, 0.95) << " / max "
+                                  << first_frame_ms.back() << " ms\n";
+                    }
+                    if (g_keyframes) {
+                        std::cout << "Forced Keyframes: " << g_keyframes->issued() << " issued, "
+                                  << g_keyframes->coalesced() << " coalesced of " << g_keyframes->requests()
+                                  << " requests, " << g_keyframes->queued() << " queued\n";
+                    }
+                    if (!g_reaped.empty()) {
+                        std::cout << "Sessions Reaped:";
+                        for (const auto& [reason, count] : g_reaped) {
+                            std::cout << " " << reason << "=" << count;
+                        }
+                        std::cout << "\n";
+                    }
+                    if (g_quality_controller) {
+                        std::cout << "Server CPU: " << g_quality_controller->GetLastCpuUtilization() * 100 << "%\n";
+                    }
                     std::cout << "Expected Bitrate Per Client: ~" 
                               << (WIDTH * HEIGHT * FPS * 0.1 / 1000000) << " Mbps\n";
                     std::cout << "Expected Aggregate Bitrate: ~" 
                               << (WIDTH * HEIGHT * FPS * 0.1 / 1000000 * g_peer_handlers.size()) << " Mbps\n";
+                    double aggregate_bps = 0;
+                    for (auto& [id, handler] : g_peer_handlers) {
+                        aggregate_bps += handler->GetLatestStats().send_bitrate_bps;
+                    }
+                    std::cout << "Measured Aggregate Bitrate: " << aggregate_bps / 1000000.0 << " Mbps\n";
+                    double ingest_bps = 0;
+                    for (auto& [id, handler] : g_peer_handlers) {
+                        SessionStats stats = handler->GetLatestStats();
+                        if (stats.frames_received == 0) continue;
+                        ingest_bps += stats.receive_bitrate_bps;
+                        std::cout << "  [" << id << "] ingest " << stats.receive_bitrate_bps / 1000000.0
+                                  << " Mbps, " << stats.receive_fps << " fps";
+                        if (stats.frames_decoded > 0) {
+                            std::cout << ", decode " << stats.decode_ms_per_frame << " ms/frame";
+                        }
+                        std::cout << "\n";
+                    }
+                    if (ingest_bps > 0) {
+                        std::cout << "Aggregate Ingest: " << ingest_bps / 1000000.0 << " Mbps\n";
+                    }
+                    if (g_dc_bench) {
+                        double sent_bytes = 0, acked_bytes = 0, seconds = 0;
+                        for (auto& [id, handler] : g_peer_handlers) {
+                            if (!handler->HasDataChannelBench()) continue;
+                            DataChannelBenchStats dc = handler->SampleDataChannelBench();
+                            sent_bytes += dc.bytes_sent;
+                            acked_bytes += dc.bytes_acked;
+                            seconds = dc.seconds;
+                            std::cout << "  [" << id << "] data channel: sent " << dc.bytes_sent / dc.seconds / 1e6
+                                      << " MB/s, acked " << dc.bytes_acked / dc.seconds / 1e6
+                                      << " MB/s, ack latency p50/p99 " << dc.ack_p50_us / 1000.0 << "/"
+                                      << dc.ack_p99_us / 1000.0 << " ms\n";
+                        }
+                        if (seconds > 0) {
+                            std::cout << "Data Channel Aggregate: sent " << sent_bytes / seconds / 1e6
+                                      << " MB/s, acked " << acked_bytes / seconds / 1e6 << " MB/s"
+                                      << (g_send_video ? " (with video)" : " (no video)") << "\n";
+                        }
+                    }
+                    if (g_shards.size() > 1) {
+                        std::cout << "Sessions Per Shard:";
+                        for (auto& shard : g_shards.shards()) {
+                            std::cout << " " << shard->session_count();
+                        }
+                        std::cout << "\n";
+                    }
+                    for (auto& [id, handler] : g_peer_handlers) {
+                        SessionStats stats = handler->GetLatestStats();
+                        std::cout << "  [" << id << "] " << SessionStateName(handler->GetState())
+                                  << (handler->IsHidden() ? " (hidden)" : "")
+                                  << ", ~" << handler->EstimateMemoryBytes() / (1024 * 1024) << " MB, encode "
+                                  << stats.encode_cpu_cores << " cores, send " << stats.send_bitrate_bps / 1000000.0
+                                  << " Mbps, target " << stats.target_bitrate_bps / 1000000.0
+                                  << " Mbps, BWE " << stats.available_outgoing_bitrate_bps / 1000000.0 << " Mbps";
+                        if (g_quality_controller) {
+                            std::cout << ", quality level " << g_quality_controller->GetLevel(id)
+                                      << " (" << (stats.quality_limitation_reason.empty() ? "none" : stats.quality_limitation_reason)
+                                      << ", encode " << stats.encode_ms_per_frame << " ms/frame)";
+                        }
+                        if (handler->IsRecording()) {
+                            std::cout << ", recorded " << handler->GetRecordedFrames() << " frames ("
+                                      << handler->GetRecordingDrops() << " dropped)";
+                        }
+                        if (handler->GetTimeToTargetMs() >= 0) {
+                            std::cout << ", time-to-target " << handler->GetTimeToTargetMs() << " ms";
+                        } else {
+                            std::cout << ", ramping";
+                        }
+                        std::cout << "\n";
+                        if (stats.tracks.size() > 1) {
+                            for (const TrackStats& track : stats.tracks) {
+                                std::cout << "      track " << track.track_id << " " << track.frame_width << "x"
+                                          << track.frame_height << " " << track.frames_per_second << " fps, send "
+                                          << track.send_bitrate_bps / 1000000.0 << " Mbps, encode "
+                                          << track.encode_ms_per_frame << " ms/frame\n";
+                            }
+                        }
+                    }
+                    // Busiest threads, to see which one saturates first
+                    std::vector<ThreadCpuUsage> threads = g_thread_cpu.Sample();
+                    if (!threads.empty()) {
+                        std::cout << "Thread CPU (cores):";
+                        for (size_t i = 0; i < threads.size() && i < 8; i++) {
+                            std::cout << " " << threads[i].name;
+                            if (threads[i].threads > 1) std::cout << "x" << threads[i].threads;
+                            std::cout << "=" << threads[i].cores;
+                        }
+                        std::cout << "\n";
+                    }
+                    // Task queue latency: where do tasks wait, and for how long
+                    for (const TaskQueueReport& queue : TaskQueueMetricsRegistry::Instance().Report()) {
+                        std::cout << "  queue " << queue.name;
+                        if (queue.queues > 1) std::cout << " x" << queue.queues;
+                        std::cout << ": " << queue.tasks << " tasks, delay p50/p99 "
+                                  << queue.delay_p50_us << "/" << queue.delay_p99_us << " us, run p50/p99 "
+                                  << queue.run_p50_us << "/" << queue.run_p99_us << " us, max depth "
+                                  << queue.max_depth << " (+" << queue.max_delayed << " delayed)\n";
+                    }
                     std::cout << "==================================\n\n";
                 }
             }
@@ -484,23 +1344,22 @@ int main(int argc, char* argv[]) {
         
         // Cleanup
         std::cout << "\nCleaning up...\n";
+        StopTraceCapture();
+        StopWebSocketSessions();
         {
             std::lock_guard<std::mutex> lock(g_peers_mutex);
             g_peer_handlers.clear();
         }
         
         int total_frames = g_video_source->GetFramesSent();
+        for (auto& source : g_track_sources) {
+            source->Stop();
+        }
+        g_track_sources.clear();
         g_video_source->Stop();
         g_video_source.reset();
-        g_factory = nullptr;
-        
-        g_signaling_thread->Stop();
-        g_worker_thread->Stop();
-        g_network_thread->Stop();
-        
-        g_signaling_thread.reset();
-        g_worker_thread.reset();
-        g_network_thread.reset();
+        g_session_shards.clear();
+        g_shards.Stop();
         
         std::cout << "Total frames generated: " << total_frames << "\n";
 
@@ -509,10 +1368,13 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    rtc::tracing::ShutdownInternalTracer();
+
 #ifdef _WIN32
     WSACleanup();
 #endif
 
+    AsyncLogger::Instance().Stop();
     std::cout << "Server stopped.\n";
     return 0;
 }
@@ -0,0 +1,426 @@
+// websocket_server.cpp
+// Implementation of the minimal WebSocket connection (handshake + framing)
+
+#include "websocket_server.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Largest message we accept from a browser (SDP offers are a few KB)
+const uint64_t kMaxMessageSize = 1024 * 1024;
+
+const uint8_t kOpContinuation = 0x0;
+const uint8_t kOpText = 0x1;
+const uint8_t kOpBinary = 0x2;
+const uint8_t kOpClose = 0x8;
+const uint8_t kOpPing = 0x9;
+const uint8_t kOpPong = 0xA;
+
+uint32_t RotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 is only needed for Sec-WebSocket-Accept, so a small local version
+// avoids pulling in a crypto dependency
+std::vector<uint8_t> Sha1(const std::string& input) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::vector<uint8_t> message(input.begin(), input.end());
+    uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+    message.push_back(0x80);
+    while (message.size() % 64 != 56) {
+        message.push_back(0);
+    }
+    for (int i = 7; i >= 0; i--) {
+        message.push_back(static_cast<uint8_t>(bit_length >> (i * 8)));
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (static_cast<uint32_t>(message[chunk + i * 4]) << 24) |
+                   (static_cast<uint32_t>(message[chunk + i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(message[chunk + i * 4 + 2]) << 8) |
+                   static_cast<uint32_t>(message[chunk + i * 4 + 3]);
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::vector<uint8_t> digest;
+    for (uint32_t word : h) {
+        digest.push_back(static_cast<uint8_t>(word >> 24));
+        digest.push_back(static_cast<uint8_t>(word >> 16));
+        digest.push_back(static_cast<uint8_t>(word >> 8));
+        digest.push_back(static_cast<uint8_t>(word));
+    }
+    return digest;
+}
+
+std::string Base64Encode(const std::vector<uint8_t>& data) {
+    static const char kAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    size_t i = 0;
+    while (i + 2 < data.size()) {
+        uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        result += kAlphabet[(n >> 18) & 63];
+        result += kAlphabet[(n >> 12) & 63];
+        result += kAlphabet[(n >> 6) & 63];
+        result += kAlphabet[n & 63];
+        i += 3;
+    }
+    if (i + 1 == data.size()) {
+        uint32_t n = data[i] << 16;
+        result += kAlphabet[(n >> 18) & 63];
+        result += kAlphabet[(n >> 12) & 63];
+        result += "==";
+    } else if (i + 2 == data.size()) {
+        uint32_t n = (data[i] << 16) | (data[i + 1] << 8);
+        result += kAlphabet[(n >> 18) & 63];
+        result += kAlphabet[(n >> 12) & 63];
+        result += kAlphabet[(n >> 6) & 63];
+        result += '=';
+    }
+    return result;
+}
+
+// Case-insensitive lookup of an HTTP header value
+std::string FindHeader(const std::string& request, const std::string& name) {
+    std::string lower_request = request;
+    std::string lower_name = name;
+    std::transform(lower_request.begin(), lower_request.end(), lower_request.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    size_t pos = lower_request.find("\r\n" + lower_name + ":");
+    if (pos == std::string::npos) return "";
+
+    pos += lower_name.length() + 3;
+    size_t end = request.find("\r\n", pos);
+    if (end == std::string::npos) end = request.length();
+
+    std::string value = request.substr(pos, end - pos);
+    size_t first = value.find_first_not_of(" \t");
+    size_t last = value.find_last_not_of(" \t");
+    if (first == std::string::npos) return "";
+    return value.substr(first, last - first + 1);
+}
+
+} // namespace
+
+bool IsWebSocketUpgradeRequest(const std::string& request) {
+    std::string upgrade = FindHeader(request, "Upgrade");
+    std::transform(upgrade.begin(), upgrade.end(), upgrade.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return request.find("GET ") == 0 && upgrade == "websocket" &&
+           !FindHeader(request, "Sec-WebSocket-Key").empty();
+}
+
+WebSocketConnection::WebSocketConnection(int fd)
+    : fd_(fd),
+      open_(false) {
+}
+
+WebSocketConnection::~WebSocketConnection() {
+    Close();
+#ifdef _WIN32
+    closesocket(fd_);
+#else
+    close(fd_);
+#endif
+}
+
+bool WebSocketConnection::Accept(const std::string& request) {
+    std::string key = FindHeader(request, "Sec-WebSocket-Key");
+    if (key.empty()) {
+        return false;
+    }
+
+    std::string accept = Base64Encode(Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: " + accept + "\r\n"
+        "\r\n";
+
+    if (!WriteAll(response.data(), response.length())) {
+        return false;
+    }
+
+    // A send that can't make progress for this long means the client
+    // stopped reading; the writer gives up on it
+#ifdef _WIN32
+    DWORD timeout = kSendTimeoutMs;
+    setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#else
+    timeval timeout{kSendTimeoutMs / 1000, (kSendTimeoutMs % 1000) * 1000};
+    setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#endif
+
+    open_ = true;
+    writer_ = std::thread(&WebSocketConnection::WriterLoop, this);
+    return true;
+}
+
+bool WebSocketConnection::ReadMessage(std::string* message) {
+    message->clear();
+
+    while (open_) {
+        uint8_t header[2];
+        if (!ReadExact(header, 2)) break;
+
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t opcode = header[0] & 0x0F;
+        bool masked = (header[1] & 0x80) != 0;
+        uint64_t length = header[1] & 0x7F;
+
+        if (length == 126) {
+            uint8_t ext[2];
+            if (!ReadExact(ext, 2)) break;
+            length = (static_cast<uint64_t>(ext[0]) << 8) | ext[1];
+        } else if (length == 127) {
+            uint8_t ext[8];
+            if (!ReadExact(ext, 8)) break;
+            length = 0;
+            for (int i = 0; i < 8; i++) {
+                length = (length << 8) | ext[i];
+            }
+        }
+
+        // Browsers must mask client frames; anything else is a protocol error
+        if (!masked || length > kMaxMessageSize ||
+            message->size() + length > kMaxMessageSize) {
+            break;
+        }
+
+        uint8_t mask[4];
+        if (!ReadExact(mask, 4)) break;
+
+        std::string payload(static_cast<size_t>(length), '\0');
+        if (length > 0 && !ReadExact(reinterpret_cast<uint8_t*>(&payload[0]), payload.size())) break;
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] ^= mask[i % 4];
+        }
+
+        if (opcode == kOpClose) {
+            break;
+        } else if (opcode == kOpPing) {
+            SendFrame(kOpPong, payload.data(), payload.size());
+            continue;
+        } else if (opcode == kOpPong) {
+            continue;
+        } else if (opcode == kOpText || opcode == kOpBinary || opcode == kOpContinuation) {
+            message->append(payload);
+            if (fin) {
+                return true;
+            }
+            continue;
+        }
+
+        // Unknown opcode
+        break;
+    }
+
+    Close();
+    return false;
+}
+
+bool WebSocketConnection::SendText(const std::string& message) {
+    return SendFrame(kOpText, message.data(), message.size());
+}
+
+void WebSocketConnection::Close() {
+    if (!open_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        send_queue_.push_back(std::string{static_cast<char>(0x80 | kOpClose), '\0'});
+        writer_stopping_ = true;
+    }
+    send_cv_.notify_one();
+    writer_.join();
+
+#ifdef _WIN32
+    shutdown(fd_, SD_BOTH);
+#else
+    shutdown(fd_, SHUT_RDWR);
+#endif
+}
+
+void WebSocketConnection::Abort() {
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (aborted_) {
+            return;
+        }
+        aborted_ = true;
+        send_queue_.clear();
+        queued_bytes_ = 0;
+    }
+    // Fails the writer's send and the reader's recv; the reader then Closes
+#ifdef _WIN32
+    shutdown(fd_, SD_BOTH);
+#else
+    shutdown(fd_, SHUT_RDWR);
+#endif
+}
+
+void WebSocketConnection::WriterLoop() {
+    std::deque<std::string> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(send_mutex_);
+            send_cv_.wait(lock, [this] { return writer_stopping_ || !send_queue_.empty(); });
+            if (send_queue_.empty()) {
+                return;
+            }
+            batch.swap(send_queue_);
+            if (aborted_) {
+                batch.clear();
+                continue;
+            }
+        }
+
+        size_t batch_bytes = 0;
+        bool ok = true;
+        for (const std::string& frame : batch) {
+            batch_bytes += frame.size();
+            if (ok && !WriteAll(frame.data(), frame.size())) {
+                ok = false;
+            }
+        }
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            queued_bytes_ = queued_bytes_ > batch_bytes ? queued_bytes_ - batch_bytes : 0;
+        }
+        if (!ok) {
+            Abort();
+        }
+    }
+}
+
+bool WebSocketConnection::ReadExact(uint8_t* data, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+#ifdef _WIN32
+        int n = recv(fd_, reinterpret_cast<char*>(data) + received, static_cast<int>(length - received), 0);
+#else
+        ssize_t n = recv(fd_, data + received, length - received, 0);
+#endif
+        if (n <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool WebSocketConnection::WriteAll(const char* data, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+#ifdef _WIN32
+        int n = send(fd_, data + sent, static_cast<int>(length - sent), 0);
+#else
+        ssize_t n = send(fd_, data + sent, length - sent, MSG_NOSIGNAL);
+#endif
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool WebSocketConnection::SendFrame(uint8_t opcode, const char* payload, size_t length) {
+    if (!open_) {
+        return false;
+    }
+
+    // Server frames are never masked
+    std::string frame;
+    frame.reserve(length + 10);
+    frame += static_cast<char>(0x80 | opcode);
+    if (length < 126) {
+        frame += static_cast<char>(length);
+    } else if (length <= 0xFFFF) {
+        frame += static_cast<char>(126);
+        frame += static_cast<char>((length >> 8) & 0xFF);
+        frame += static_cast<char>(length & 0xFF);
+    } else {
+        frame += static_cast<char>(127);
+        for (int i = 7; i >= 0; i--) {
+            frame += static_cast<char>((static_cast<uint64_t>(length) >> (i * 8)) & 0xFF);
+        }
+    }
+    frame.append(payload, length);
+
+    bool overflow = false;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (aborted_ || writer_stopping_) {
+            return false;
+        }
+        if (queued_bytes_ + frame.size() > kMaxQueuedBytes) {
+            overflow = true;
+        } else {
+            queued_bytes_ += frame.size();
+            send_queue_.push_back(std::move(frame));
+        }
+    }
+    if (overflow) {
+        Abort();
+        return false;
+    }
+    send_cv_.notify_one();
+    return true;
+}
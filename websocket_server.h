@@ -0,0 +1,70 @@
+// websocket_server.h
+// Minimal RFC 6455 WebSocket connection for native browser signaling
+
+#ifndef WEBSOCKET_SERVER_H
+#define WEBSOCKET_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Returns true if a raw HTTP request asks to be upgraded to a WebSocket
+bool IsWebSocketUpgradeRequest(const std::string& request);
+
+// Server side of one WebSocket connection.
+// Reads happen on the session's own thread. Sends may come from any WebRTC
+// callback thread (answer, ICE candidates); they only queue the frame, and
+// the connection's writer thread puts it on the socket, so a client that
+// stops reading never stalls a shard's signaling thread. A client that
+// falls kMaxQueuedBytes behind, or blocks a send for kSendTimeoutMs, is
+// disconnected.
+class WebSocketConnection {
+public:
+    static constexpr size_t kMaxQueuedBytes = 1024 * 1024;
+    static constexpr int kSendTimeoutMs = 5000;
+
+    explicit WebSocketConnection(int fd);
+    ~WebSocketConnection();
+
+    // Completes the opening handshake for an upgrade request
+    bool Accept(const std::string& request);
+
+    // Blocks until a complete text message arrives.
+    // Returns false once the peer closed the connection or on error.
+    bool ReadMessage(std::string* message);
+
+    // Queues a single text frame (thread-safe, never blocks on the socket)
+    bool SendText(const std::string& message);
+
+    // Sends what's queued and a close frame, then shuts the socket down,
+    // unblocking ReadMessage
+    void Close();
+
+    bool IsOpen() const { return open_; }
+
+private:
+    bool ReadExact(uint8_t* data, size_t length);
+    bool WriteAll(const char* data, size_t length);
+    bool SendFrame(uint8_t opcode, const char* payload, size_t length);
+    void WriterLoop();
+    // Drops the connection without waiting for the writer (any thread)
+    void Abort();
+
+    int fd_;
+    std::atomic<bool> open_;
+
+    std::mutex send_mutex_;
+    std::condition_variable send_cv_;
+    std::deque<std::string> send_queue_;  // Complete frames
+    size_t queued_bytes_ = 0;
+    bool writer_stopping_ = false;
+    bool aborted_ = false;
+    std::thread writer_;
+};
+
+#endif // WEBSOCKET_SERVER_H